@@ -0,0 +1,528 @@
+/**
+ *  @brief Headless benchmark of chunk generation and meshing, no window and no Vulkan device.
+ *  Generates and meshes the same chunks along a fixed camera path for every thread count and reports per stage
+ *  timing percentiles, vertices per chunk, heap allocations and chunks per second as JSON.
+ *
+ *  Before that the padded volume shell of the first path chunk is checked against the noise across its borders.
+ *
+ *  With --worlds N the path is generated once more in N independent ChunkHandlers sharing one JobSystem, the first
+ *  world then evicts it, generates it again and evicts it again to check that every chunk gets deleted. --trace
+ *  writes the zones the generation recorded as Chrome trace JSON.
+ *
+ *  voxle_bench [--chunks N] [--threads 1,2,4] [--mesher naive|greedy|binary] [--worlds N] [--trace path]
+ *              [--json path]
+ *  The JSON goes to voxle_bench.json by default, "--json -" prints it to stdout where the engine logs go as well.
+ **/
+
+#include "World/Chunk.hpp"
+#include "World/ChunkMesher.hpp"
+#include "World/TerrainNoise.hpp"
+#include "World/ChunkMap.hpp"
+#include "World/ChunkHandler.hpp"
+#include "World/ChunkEvictor.hpp"
+#include "Threading/JobSystem.hpp"
+#include "Logging/Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// >---- ALLOCATION TRACKING -----<
+
+static std::atomic<uint64_t> allocatedBytes{0};
+static std::atomic<uint64_t> allocationCount{0};
+
+void *operator new(size_t size) {
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+// >---- SETUP -----<
+
+struct BenchConfig {
+  size_t chunkCount = 512;
+  std::vector<uint32_t> threadCounts{};
+  MeshingMode mode = MeshingMode::BINARY;
+  uint32_t worldCount = 0;
+  std::string tracePath{};
+  std::string jsonPath = "voxle_bench.json";
+};
+
+struct Percentiles {
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+};
+
+struct BenchRun {
+  uint32_t threads = 0;
+  double wallSeconds = 0.0;
+  double chunksPerSecond = 0.0;
+  Percentiles noiseMicros{};
+  Percentiles fillMicros{};
+  Percentiles meshMicros{};
+  Percentiles verticesPerChunk{};
+  uint64_t totalVertices = 0;
+  uint64_t bytesAllocated = 0;
+  uint64_t allocations = 0;
+  uint64_t retainedBytes = 0;
+  size_t generatedChunks = 0;
+  size_t uniformChunks = 0;
+  size_t emptyChunks = 0;
+};
+
+struct WorldsRun {
+  uint32_t worlds = 0;
+  uint32_t threads = 0;
+  double wallSeconds = 0.0;
+  double chunksPerSecond = 0.0;
+  bool deterministic = true;
+  // Every chunk was deleted after unloading the path, flying back and unloading it again
+  bool drained = true;
+};
+
+static Percentiles computePercentiles(std::vector<double> values) {
+  Percentiles result{};
+  if (values.empty()) return result;
+
+  std::sort(values.begin(), values.end());
+  auto at = [&values](double fraction) {
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * static_cast<double>(values.size())))];
+  };
+  result.p50 = at(0.50);
+  result.p90 = at(0.90);
+  result.p99 = at(0.99);
+  result.max = values.back();
+
+  double sum = 0.0;
+  for (double value: values) sum += value;
+  result.mean = sum / static_cast<double>(values.size());
+  return result;
+}
+
+/**
+ *  @brief The camera flies along +x at height 0, one chunk per step. Every step adds the chunks within four chunks of
+ *  the camera, nearest first, until count chunks are collected. Always the same chunks in the same order.
+ **/
+static std::vector<glm::ivec3> buildCameraPath(size_t count) {
+  const int radius = 4;
+  std::vector<glm::ivec3> sphere;
+  for (int z = -radius; z <= radius; ++z) {
+    for (int y = -radius; y <= radius; ++y) {
+      for (int x = -radius; x <= radius; ++x) {
+        if (x * x + y * y + z * z <= radius * radius) sphere.emplace_back(x, y, z);
+      }
+    }
+  }
+  std::stable_sort(sphere.begin(), sphere.end(), [](const glm::ivec3 &a, const glm::ivec3 &b) {
+    return a.x * a.x + a.y * a.y + a.z * a.z < b.x * b.x + b.y * b.y + b.z * b.z;
+  });
+
+  std::vector<glm::ivec3> path;
+  std::unordered_set<glm::ivec3, ChunkPosHash> added;
+  for (int step = 0; path.size() < count; ++step) {
+    for (const glm::ivec3 &offset: sphere) {
+      const glm::ivec3 pos = glm::ivec3(step, 0, 0) + offset;
+      if (added.insert(pos).second) path.push_back(pos);
+      if (path.size() == count) break;
+    }
+  }
+  return path;
+}
+
+/**
+ *  @brief Runs every job on the workers and blocks until they are done. The calling thread only waits, so exactly
+ *  as many threads as the JobSystem has workers do the work.
+ **/
+static void runJobs(JobSystem &jobSystem, size_t count, const std::function<void(size_t)> &job) {
+  std::atomic<size_t> remaining{count};
+  for (size_t i = 0; i < count; ++i) {
+    jobSystem.schedule([&job, &remaining, i] {
+      job(i);
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+  while (remaining.load(std::memory_order_acquire) != 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+static double microsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+  return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+// >---- BORDER CHECK -----<
+
+/**
+ *  @brief The meshers only see the neighbours through the padded volume shell, which has to hold the voxels the
+ *  noise puts on the other side of the border. Generates the chunk at pos and its six neighbours, then compares
+ *  every shell voxel with the continuous noise sampled at the same position. Returns the mismatching voxels.
+ **/
+static size_t checkBorders(const glm::ivec3 &pos) {
+  std::vector<float> noise(CHUNK_VOLUME);
+  auto generate = [&noise](const glm::ivec3 &chunkPos) {
+    auto chunk = std::make_unique<Chunk>(chunkPos);
+    TerrainNoise::evaluate(chunkPos, 1, noise.data());
+    chunk->generate(noise.data());
+    return chunk;
+  };
+
+  const std::unique_ptr<Chunk> chunk = generate(pos);
+  std::vector<std::unique_ptr<Chunk>> owned;
+  ChunkNeighbours neighbours{};
+  for (int dir = 0; dir < 6; ++dir) {
+    owned.push_back(generate(pos + directionOffsets[dir]));
+    neighbours.chunks[dir] = owned.back().get();
+  }
+
+  ChunkMesher::PaddedVolume volume{};
+  ChunkMesher::buildPaddedVolume(*chunk, neighbours, volume);
+
+  size_t mismatches = 0;
+  auto compare = [&](const glm::ivec3 &voxel) {
+    const bool expected = TerrainNoise::sample(pos, voxel) <= SOLID_DENSITY;
+    if ((volume.get(voxel.x, voxel.y, voxel.z).id > 0) != expected) mismatches++;
+  };
+  for (int a = 0; a < CHUNK_SIZE; ++a) {
+    for (int b = 0; b < CHUNK_SIZE; ++b) {
+      compare({-1, a, b});
+      compare({CHUNK_SIZE, a, b});
+      compare({a, -1, b});
+      compare({a, CHUNK_SIZE, b});
+      compare({a, b, -1});
+      compare({a, b, CHUNK_SIZE});
+    }
+  }
+  return mismatches;
+}
+
+// >---- BENCHMARK -----<
+
+/**
+ *  @brief Generates the voxels of the path chunks and their neighbours, then meshes the path chunks, the same stages
+ *  the ChunkHandler runs. Noise covers the coarse classification and the full noise evaluation, fill the density to
+ *  material threshold.
+ **/
+static BenchRun runBenchmark(const std::vector<glm::ivec3> &path, uint32_t threads) {
+  using Clock = std::chrono::steady_clock;
+
+  // Neighbours are generated as well so the path chunks mesh against real border voxels
+  std::vector<glm::ivec3> positions = path;
+  std::unordered_set<glm::ivec3, ChunkPosHash> known(path.begin(), path.end());
+  for (const glm::ivec3 &pos: path) {
+    for (const glm::ivec3 &offset: directionOffsets) {
+      if (known.insert(pos + offset).second) positions.push_back(pos + offset);
+    }
+  }
+
+  std::vector<Chunk *> chunks(positions.size(), nullptr);
+  std::vector<double> noiseMicros(positions.size(), 0.0);
+  std::vector<double> fillMicros(positions.size(), 0.0);
+  std::vector<double> meshMicros(path.size(), 0.0);
+  std::vector<double> vertices(path.size(), 0.0);
+  std::vector<uint8_t> uniform(positions.size(), 0);
+
+  JobSystem jobSystem{};
+  jobSystem.start(threads);
+
+  const uint64_t bytesBefore = allocatedBytes.load();
+  const uint64_t allocationsBefore = allocationCount.load();
+  const Clock::time_point start = Clock::now();
+
+  runJobs(jobSystem, positions.size(), [&](size_t i) {
+    thread_local std::vector<float> noise(CHUNK_VOLUME);
+    auto *chunk = new Chunk{positions[i]};
+
+    const Clock::time_point noiseStart = Clock::now();
+    const TerrainNoise::NoiseClass noiseClass = TerrainNoise::classify(positions[i]);
+    if (noiseClass == TerrainNoise::NoiseClass::MIXED) TerrainNoise::evaluate(positions[i], 1, noise.data());
+    const Clock::time_point fillStart = Clock::now();
+
+    if (noiseClass == TerrainNoise::NoiseClass::MIXED) {
+      chunk->generate(noise.data());
+    } else {
+      chunk->generateUniform(noiseClass == TerrainNoise::NoiseClass::SOLID ? Materials::SOLID : Materials::AIR);
+      uniform[i] = 1;
+    }
+    const Clock::time_point fillEnd = Clock::now();
+
+    noiseMicros[i] = microsBetween(noiseStart, fillStart);
+    fillMicros[i] = microsBetween(fillStart, fillEnd);
+    chunks[i] = chunk;
+  });
+
+  // Read only from here on
+  ChunkMap chunkMap{};
+  for (Chunk *chunk: chunks) chunkMap.insert(chunk->getPos(), chunk);
+
+  runJobs(jobSystem, path.size(), [&](size_t i) {
+    Chunk *chunk = chunks[i];
+    ChunkNeighbours neighbours{};
+    for (int dir = 0; dir < 6; ++dir) {
+      neighbours.chunks[dir] = chunkMap.find(path[i] + directionOffsets[dir]);
+    }
+
+    const Clock::time_point meshStart = Clock::now();
+    chunk->regenerateMesh(neighbours);
+    meshMicros[i] = microsBetween(meshStart, Clock::now());
+    vertices[i] = static_cast<double>(chunk->getChunkMesh().vertices.size());
+  });
+
+  const Clock::time_point end = Clock::now();
+
+  BenchRun run{};
+  run.threads = threads;
+  run.bytesAllocated = allocatedBytes.load() - bytesBefore;
+  run.allocations = allocationCount.load() - allocationsBefore;
+  run.wallSeconds = std::chrono::duration<double>(end - start).count();
+  run.chunksPerSecond = static_cast<double>(path.size()) / run.wallSeconds;
+  run.noiseMicros = computePercentiles(noiseMicros);
+  run.fillMicros = computePercentiles(fillMicros);
+  run.meshMicros = computePercentiles(meshMicros);
+  run.verticesPerChunk = computePercentiles(vertices);
+  run.generatedChunks = positions.size();
+
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    run.retainedBytes += chunks[i]->getMemoryUsage();
+    run.uniformChunks += uniform[i];
+    if (i < path.size()) {
+      run.totalVertices += chunks[i]->getChunkMesh().vertices.size();
+      if (chunks[i]->isChunkEmpty()) run.emptyChunks++;
+    }
+  }
+
+  jobSystem.stop();
+  for (Chunk *chunk: chunks) delete chunk;
+  return run;
+}
+
+/**
+ *  @brief Queues the path in worldCount ChunkHandlers without storage and waits until all of them are done.
+ *  Every world generates the same terrain, so all of them have to end up with the same vertices.
+ **/
+static WorldsRun runWorlds(const std::vector<glm::ivec3> &path, uint32_t worldCount, uint32_t threads) {
+  using Clock = std::chrono::steady_clock;
+
+  JobSystem jobSystem{};
+  jobSystem.start(threads);
+
+  std::vector<std::unique_ptr<ChunkHandler>> worlds;
+  for (uint32_t i = 0; i < worldCount; ++i) worlds.push_back(std::make_unique<ChunkHandler>(jobSystem));
+
+  const Clock::time_point start = Clock::now();
+  for (const glm::ivec3 &pos: path) {
+    for (auto &world: worlds) world->addChunkToQueue(pos);
+  }
+  for (auto &world: worlds) world->waitIdle();
+  const Clock::time_point end = Clock::now();
+
+  WorldsRun run{};
+  run.worlds = worldCount;
+  run.threads = threads;
+  run.wallSeconds = std::chrono::duration<double>(end - start).count();
+  run.chunksPerSecond = static_cast<double>(path.size() * worldCount) / run.wallSeconds;
+
+  uint64_t firstVertices = 0;
+  for (size_t i = 0; i < worlds.size(); ++i) {
+    uint64_t totalVertices = 0;
+    for (Chunk *chunk: worlds[i]->getChunksGenerated()) totalVertices += chunk->getChunkMesh().vertices.size();
+    if (i == 0) firstVertices = totalVertices;
+    if (totalVertices != firstVertices) run.deterministic = false;
+  }
+
+  // Fly away, come back and fly away again. A chunk some job forgot to release would stay in the unload list.
+  ChunkHandler &world = *worlds.front();
+  ChunkEvictor evictor{world, nullptr, [](const Mesh &) { return size_t{0}; }, [](const glm::ivec3 &, const Mesh &) {}};
+  const glm::vec3 farAway{1.0e6f, 0.0f, 1.0e6f};
+  evictor.update(farAway, 1.0f, 1);
+  for (const glm::ivec3 &pos: path) world.addChunkToQueue(pos);
+  world.waitIdle();
+  evictor.update(farAway, 1.0f, 1);
+  run.drained = world.getUnloadedChunks() == 0;
+
+  jobSystem.stop();
+  return run;
+}
+
+// >---- OUTPUT -----<
+
+static void writePercentiles(std::ostream &out, const char *name, const Percentiles &p) {
+  out << "      \"" << name << "\": {\"p50\": " << p.p50 << ", \"p90\": " << p.p90 << ", \"p99\": " << p.p99
+      << ", \"max\": " << p.max << ", \"mean\": " << p.mean << "}";
+}
+
+static std::string toJson(const BenchConfig &config, const std::vector<BenchRun> &runs, const WorldsRun &worlds) {
+  std::ostringstream out;
+  out << "{\n";
+  out << "  \"benchmark\": \"voxle_bench\",\n";
+  out << "  \"chunks\": " << config.chunkCount << ",\n";
+  out << "  \"chunkSize\": " << CHUNK_SIZE << ",\n";
+  out << "  \"seed\": " << TerrainNoise::SEED << ",\n";
+  out << "  \"mesher\": \"" << ChunkMesher::getModeName(config.mode) << "\",\n";
+  out << "  \"runs\": [\n";
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const BenchRun &run = runs[i];
+    out << "    {\n";
+    out << "      \"threads\": " << run.threads << ",\n";
+    out << "      \"wallSeconds\": " << run.wallSeconds << ",\n";
+    out << "      \"chunksPerSecond\": " << run.chunksPerSecond << ",\n";
+    out << "      \"generatedChunks\": " << run.generatedChunks << ",\n";
+    out << "      \"uniformChunks\": " << run.uniformChunks << ",\n";
+    out << "      \"emptyChunks\": " << run.emptyChunks << ",\n";
+    out << "      \"totalVertices\": " << run.totalVertices << ",\n";
+    out << "      \"bytesAllocated\": " << run.bytesAllocated << ",\n";
+    out << "      \"allocations\": " << run.allocations << ",\n";
+    out << "      \"retainedBytes\": " << run.retainedBytes << ",\n";
+    writePercentiles(out, "noiseMicros", run.noiseMicros);
+    out << ",\n";
+    writePercentiles(out, "fillMicros", run.fillMicros);
+    out << ",\n";
+    writePercentiles(out, "meshMicros", run.meshMicros);
+    out << ",\n";
+    writePercentiles(out, "verticesPerChunk", run.verticesPerChunk);
+    out << "\n    }" << (i + 1 < runs.size() ? "," : "") << "\n";
+  }
+  out << "  ]";
+  if (worlds.worlds > 0) {
+    out << ",\n  \"worlds\": {\"count\": " << worlds.worlds << ", \"threads\": " << worlds.threads
+        << ", \"wallSeconds\": " << worlds.wallSeconds << ", \"chunksPerSecond\": " << worlds.chunksPerSecond
+        << ", \"deterministic\": " << (worlds.deterministic ? "true" : "false")
+        << ", \"drained\": " << (worlds.drained ? "true" : "false") << "}";
+  }
+  out << "\n";
+  out << "}\n";
+  return out.str();
+}
+
+static bool parseArguments(int argc, char **argv, BenchConfig &config) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+
+    if (arg == "--chunks" && hasValue) {
+      config.chunkCount = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && hasValue) {
+      std::stringstream list(argv[++i]);
+      std::string entry;
+      while (std::getline(list, entry, ',')) {
+        const auto threads = static_cast<uint32_t>(std::strtoul(entry.c_str(), nullptr, 10));
+        if (threads > 0) config.threadCounts.push_back(threads);
+      }
+    } else if (arg == "--mesher" && hasValue) {
+      const std::string name = argv[++i];
+      if (name == "naive") config.mode = MeshingMode::NAIVE;
+      else if (name == "greedy") config.mode = MeshingMode::GREEDY;
+      else if (name == "binary") config.mode = MeshingMode::BINARY;
+      else return false;
+    } else if (arg == "--worlds" && hasValue) {
+      config.worldCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--trace" && hasValue) {
+      config.tracePath = argv[++i];
+    } else if (arg == "--json" && hasValue) {
+      config.jsonPath = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return config.chunkCount > 0;
+}
+
+int main(int argc, char **argv) {
+  voxle::logging::applyLevelsFromEnvironment();
+  BenchConfig config{};
+  if (!parseArguments(argc, argv, config)) {
+    std::fprintf(stderr, "Usage: voxle_bench [--chunks N] [--threads 1,2,4] [--mesher naive|greedy|binary] "
+                         "[--worlds N] [--trace path] [--json path]\n");
+    return 1;
+  }
+
+  if (config.threadCounts.empty()) {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t threads = 1; threads < cores; threads *= 2) config.threadCounts.push_back(threads);
+    config.threadCounts.push_back(cores);
+  }
+
+  ChunkMesher::setMode(config.mode);
+  const std::vector<glm::ivec3> path = buildCameraPath(config.chunkCount);
+
+  // Faces along the borders are culled against the shell, wrong shell voxels drop or add border faces
+  const size_t borderMismatches = checkBorders(path.front());
+  if (borderMismatches != 0) {
+    std::fprintf(stderr, "%zu padded volume shell voxels differ from the noise across the chunk border\n",
+                 borderMismatches);
+    return 1;
+  }
+
+  std::vector<BenchRun> runs;
+  for (uint32_t threads: config.threadCounts) {
+    runs.push_back(runBenchmark(path, threads));
+    const BenchRun &run = runs.back();
+    std::fprintf(stderr, "%2u threads: %8.1f chunks/s | noise p50 %7.1fus | fill p50 %6.1fus | mesh p50 %7.1fus | "
+                         "%6.0f vertices/chunk\n", run.threads, run.chunksPerSecond, run.noiseMicros.p50,
+                 run.fillMicros.p50, run.meshMicros.p50, run.verticesPerChunk.mean);
+
+    // Same seed and same chunks, anything else is a bug
+    if (run.totalVertices != runs.front().totalVertices) {
+      std::fprintf(stderr, "Vertex count differs from the first run, generation is not deterministic\n");
+    }
+  }
+
+  WorldsRun worlds{};
+  if (config.worldCount > 0) {
+    worlds = runWorlds(path, config.worldCount, config.threadCounts.back());
+    std::fprintf(stderr, "%2u worlds on %u threads: %8.1f chunks/s\n", worlds.worlds, worlds.threads,
+                 worlds.chunksPerSecond);
+    if (!worlds.deterministic) std::fprintf(stderr, "Worlds differ from each other, generation is not deterministic\n");
+    if (!worlds.drained) std::fprintf(stderr, "Unloaded chunks are still pinned after flying away and back\n");
+  }
+  if (!config.tracePath.empty()) Profiler::exportTrace(config.tracePath);
+
+  const std::string json = toJson(config, runs, worlds);
+  if (config.jsonPath == "-") {
+    std::fputs(json.c_str(), stdout);
+    return 0;
+  }
+
+  std::ofstream file(config.jsonPath);
+  if (!(file << json)) {
+    std::fprintf(stderr, "Failed to write %s\n", config.jsonPath.c_str());
+    return 1;
+  }
+  std::fprintf(stderr, "Wrote %s\n", config.jsonPath.c_str());
+  return 0;
+}
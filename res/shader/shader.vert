@@ -13,8 +13,15 @@ layout(push_constant) uniform constants {
     vec4 data;
     mat4 transform;
 } PushConstants;
+
+// World offset of every chunk draw, indexed by the draws firstInstance
+layout(std430, binding = 2) readonly buffer ChunkDrawData {
+    vec4 chunkOffsets[];
+} chunkData;
 // Packed vertex values
 layout(location = 0) in uint packedVertData;
+// Quad width | height << 6
+layout(location = 1) in uint packedQuadData;
 
 layout(location = 1) out vec3 texCoord_Layer;
 
@@ -40,8 +47,11 @@ void main() {
     uint index = (packedVertData & 0x600000u) >> 21u;
     uint layer = (packedVertData & 0xFF800000u) >> 23u;
 
-    gl_Position = PushConstants.transform * vec4(x, y, z, 1.0);
+    float quadWidth = float(packedQuadData & 0x3Fu);
+    float quadHeight = float((packedQuadData & 0xFC0u) >> 6u);
+
+    gl_Position = PushConstants.transform * vec4(vec3(x, y, z) + chunkData.chunkOffsets[gl_InstanceIndex].xyz, 1.0);
 
     // Out texture UV's and Array Depth
-    texCoord_Layer = vec3(texCoord[index], 1);
+    texCoord_Layer = vec3(texCoord[index] * vec2(quadWidth, quadHeight), float(layer));
 }
\ No newline at end of file
@@ -5,4 +5,7 @@ C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -
 C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/wireframe.frag.spv res/shader/wireframe.frag
 
 C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/debug.vert.spv res/shader/debug.vert
-C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/debug.frag.spv res/shader/debug.frag
\ No newline at end of file
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/debug.frag.spv res/shader/debug.frag
+
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/chunk_cull.comp.spv res/shader/chunk_cull.comp
+C:/VulkanSDK/1.3.239.0/Bin/glslangValidator.exe --target-env vulkan1.2 -e main -o res/shader/compiled/depth_reduce.comp.spv res/shader/depth_reduce.comp
\ No newline at end of file
@@ -15,6 +15,9 @@ public:
 
   bool isColliding(AABB& collider) const;
 
+  [[nodiscard]] const Point& getCenter() const { return center; }
+  [[nodiscard]] const Point& getHalfWidth() const { return halfWidth; }
+
   std::pair<std::vector<Vertex>, std::vector<uint32_t>> getMeshDefinition();
 
 private:
@@ -0,0 +1,117 @@
+#include "Frustum.hpp"
+
+#include <cmath>
+#include <xmmintrin.h>
+
+/**
+ *  @brief Extracts the planes from the combined matrix (Gribb/Hartmann).
+ *  The near plane uses the -w <= z convention, for a 0..1 depth range that only makes it more conservative.
+ **/
+Frustum::Frustum(const glm::mat4 &viewProj) {
+  // glm is column major, row i is m[0][i], m[1][i], m[2][i], m[3][i]
+  auto row = [&viewProj](int i) {
+    return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+  };
+
+  planes[0] = row(3) + row(0); // Left
+  planes[1] = row(3) - row(0); // Right
+  planes[2] = row(3) + row(1); // Bottom
+  planes[3] = row(3) - row(1); // Top
+  planes[4] = row(3) + row(2); // Near
+  planes[5] = row(3) - row(2); // Far
+}
+
+/**
+ *  @brief True if the box is at least partially inside. Boxes close to a corner can pass without being visible.
+ **/
+bool Frustum::isVisible(const AABB &box) const {
+  const Point &c = box.getCenter();
+  const Point &h = box.getHalfWidth();
+
+  for (const glm::vec4 &plane: planes) {
+    // Distance of the center against the projected radius of the box, planes don't have to be normalized for this
+    const float distance = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w;
+    const float radius = std::fabs(plane.x) * h.x + std::fabs(plane.y) * h.y + std::fabs(plane.z) * h.z;
+    if (distance + radius < 0.0f) return false;
+  }
+  return true;
+}
+
+void AABBBatch::clear() {
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  halfX.clear();
+  halfY.clear();
+  halfZ.clear();
+}
+
+void AABBBatch::push(const AABB &box) {
+  centerX.push_back(box.getCenter().x);
+  centerY.push_back(box.getCenter().y);
+  centerZ.push_back(box.getCenter().z);
+  halfX.push_back(box.getHalfWidth().x);
+  halfY.push_back(box.getHalfWidth().y);
+  halfZ.push_back(box.getHalfWidth().z);
+}
+
+/**
+ *  @brief Sets visible[i] to 1 for every box that is at least partially inside, returns the amount of visible boxes.
+ *  Same test as Frustum::isVisible with four boxes per SSE instruction.
+ **/
+uint32_t AABBBatch::cull(const Frustum &frustum, std::vector<uint8_t> &visible) const {
+  const size_t count = size();
+  visible.resize(count);
+
+  const std::array<glm::vec4, 6> &planes = frustum.getPlanes();
+
+  // Plane components and their absolute values, broadcast once
+  __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+  for (int p = 0; p < 6; ++p) {
+    px[p] = _mm_set1_ps(planes[p].x);
+    py[p] = _mm_set1_ps(planes[p].y);
+    pz[p] = _mm_set1_ps(planes[p].z);
+    pw[p] = _mm_set1_ps(planes[p].w);
+    ax[p] = _mm_set1_ps(std::fabs(planes[p].x));
+    ay[p] = _mm_set1_ps(std::fabs(planes[p].y));
+    az[p] = _mm_set1_ps(std::fabs(planes[p].z));
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+  uint32_t visibleCount = 0;
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 cx = _mm_loadu_ps(&centerX[i]);
+    const __m128 cy = _mm_loadu_ps(&centerY[i]);
+    const __m128 cz = _mm_loadu_ps(&centerZ[i]);
+    const __m128 hx = _mm_loadu_ps(&halfX[i]);
+    const __m128 hy = _mm_loadu_ps(&halfY[i]);
+    const __m128 hz = _mm_loadu_ps(&halfZ[i]);
+
+    // Lanes stay set while the box is in front of every plane so far
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; ++p) {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                                   _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+      __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], hx), _mm_mul_ps(ay[p], hy)), _mm_mul_ps(az[p], hz));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+    }
+
+    const int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; ++lane) {
+      const uint8_t isVisible = (mask >> lane) & 1;
+      visible[i + lane] = isVisible;
+      visibleCount += isVisible;
+    }
+  }
+
+  // Remaining boxes
+  for (; i < count; ++i) {
+    AABB box{Point{centerX[i], centerY[i], centerZ[i]}, Point{halfX[i], halfY[i], halfZ[i]}};
+    visible[i] = frustum.isVisible(box) ? 1 : 0;
+    visibleCount += visible[i];
+  }
+
+  return visibleCount;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "AABB.hpp"
+
+/**
+ *  @brief The six planes of a view frustum, normals point inwards.
+ **/
+class Frustum {
+public:
+  explicit Frustum(const glm::mat4 &viewProj);
+
+  [[nodiscard]] bool isVisible(const AABB &box) const;
+  [[nodiscard]] const std::array<glm::vec4, 6> &getPlanes() const { return planes; }
+
+private:
+  std::array<glm::vec4, 6> planes{};
+};
+
+/**
+ *  @brief Many AABBs as structure of arrays so they can be tested against a frustum four at a time.
+ **/
+class AABBBatch {
+public:
+  void clear();
+  void push(const AABB &box);
+
+  [[nodiscard]] size_t size() const { return centerX.size(); }
+
+  uint32_t cull(const Frustum &frustum, std::vector<uint8_t> &visible) const;
+
+private:
+  std::vector<float> centerX;
+  std::vector<float> centerY;
+  std::vector<float> centerZ;
+  std::vector<float> halfX;
+  std::vector<float> halfY;
+  std::vector<float> halfZ;
+};
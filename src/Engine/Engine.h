@@ -6,10 +6,13 @@
 
 // Rendering
 #include <VulkanPipeline/VulkanInstance.h>
+#include <Renderer/ChunkResources.h>
 #include <glm/glm.hpp>
 
 #include <Threading/ThreadPool.hpp>
 #include <World/ChunkHandler.hpp>
+#include <World/ChunkEvictor.hpp>
+#include <World/RegionStorage.hpp>
 
 #include <string>
 #include <thread>
@@ -30,7 +33,11 @@ public:
 
     ThreadPool threadPool{};
 
-    ChunkHandler chunkHandler{};
+    // Declared before the chunkHandler, it is handed the storage on construction
+    RegionStorage regionStorage{};
+    ChunkHandler chunkHandler{threadPool.getJobSystem(), &regionStorage};
+    ChunkEvictor chunkEvictor{chunkHandler, &regionStorage, ChunkResources::getMeshVram,
+                              ChunkResources::releaseMesh};
 
     static EngineData *i() {
       static EngineData instance{};
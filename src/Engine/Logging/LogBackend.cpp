@@ -0,0 +1,304 @@
+#include "LogBackend.hpp"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace voxle::logging {
+namespace {
+
+  struct LogRecord {
+    Severity severity{};
+    uint64_t sequence{0};
+    std::string text;
+
+    // Set for deferred statements, text is empty then
+    DeferredFormatter formatter{nullptr};
+    const char *format{nullptr};
+    const char *file{nullptr};
+    int line{0};
+    uint8_t args[DEFERRED_ARGS_SIZE]{};
+  };
+
+  /**
+   *  @brief Ring of records with the owning thread as the only producer. Consumers have to hold drainMutex.
+   **/
+  struct LogQueue {
+    std::unique_ptr<LogRecord[]> records = std::make_unique<LogRecord[]>(LOG_QUEUE_SIZE);
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    // The owning thread exited, the queue is removed once it is empty
+    std::atomic<bool> abandoned{false};
+
+    bool push(LogRecord &&record) {
+      const uint64_t index = tail.load(std::memory_order_relaxed);
+      if (index - head.load(std::memory_order_acquire) == LOG_QUEUE_SIZE) return false;
+
+      records[index % LOG_QUEUE_SIZE] = std::move(record);
+      tail.store(index + 1, std::memory_order_release);
+      return true;
+    }
+
+    void drainInto(std::vector<LogRecord> &out) {
+      uint64_t index = head.load(std::memory_order_relaxed);
+      const uint64_t end = tail.load(std::memory_order_acquire);
+      for (; index < end; ++index) out.push_back(std::move(records[index % LOG_QUEUE_SIZE]));
+      head.store(index, std::memory_order_release);
+    }
+
+    [[nodiscard]] uint64_t size() const {
+      return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+  };
+
+  void appendLine(std::string &out, LogRecord &record) {
+    switch (record.severity) {
+    case Severity::D: out += "\x1B[32m[DEBUG] "; break;
+    case Severity::I: out += "\x1B[37m[INFO ] "; break;
+    case Severity::W: out += "\x1B[33m[WARN ] "; break;
+    case Severity::E: out += "\x1B[31m[ERROR] "; break;
+    case Severity::F: out += "\x1B[91m[FATAL] "; break;
+    }
+
+    if (record.formatter != nullptr) {
+      out += getFileName(record.file);
+      out += ':';
+      out += std::to_string(record.line);
+      out += ' ';
+      record.formatter(record.format, record.args, out);
+    } else {
+      out += record.text;
+    }
+
+    if (record.severity == Severity::D || record.severity == Severity::I || record.severity == Severity::F) {
+      out += "\033[0m";
+    }
+    out += '\n';
+  }
+
+  class Backend {
+  public:
+    Backend() : writer(&Backend::writerLoop, this) {}
+
+    ~Backend() {
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+      }
+      wakeCond.notify_all();
+      writer.join();
+      drainAll();
+    }
+
+    std::shared_ptr<LogQueue> registerQueue() {
+      auto queue = std::make_shared<LogQueue>();
+      std::lock_guard<std::mutex> lock(registryMutex);
+      queues.push_back(queue);
+      return queue;
+    }
+
+    void wake() {
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeRequested = true;
+      }
+      wakeCond.notify_one();
+    }
+
+    /**
+     *  @brief Writes everything queued in the order it was logged, on the calling thread.
+     **/
+    void drainAll() {
+      std::lock_guard<std::mutex> drainLock(drainMutex);
+      {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto &queue: queues) queue->drainInto(batch);
+        // Nothing pushes to an abandoned queue anymore
+        queues.erase(std::remove_if(queues.begin(), queues.end(), [](const std::shared_ptr<LogQueue> &queue) {
+          return queue->abandoned.load(std::memory_order_acquire) && queue->size() == 0;
+        }), queues.end());
+      }
+
+      const uint64_t dropped = droppedMessages.load(std::memory_order_relaxed);
+      if (batch.empty() && dropped == reportedDrops) return;
+
+      std::sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) {
+        return a.sequence < b.sequence;
+      });
+
+      output.clear();
+      for (LogRecord &record: batch) appendLine(output, record);
+      if (dropped != reportedDrops) {
+        output += "\x1B[33m[WARN ] Dropped " + std::to_string(dropped - reportedDrops) +
+                  " log messages, the log queue of a thread was full\n";
+        reportedDrops = dropped;
+      }
+      batch.clear();
+
+      std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+      std::cout.flush();
+    }
+
+    std::atomic<uint64_t> nextSequence{0};
+    std::atomic<uint64_t> droppedMessages{0};
+
+  private:
+    void writerLoop() {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      while (running) {
+        // Batches whatever piled up in the meantime
+        wakeCond.wait_for(lock, std::chrono::milliseconds(10), [this] { return wakeRequested || !running; });
+        wakeRequested = false;
+        lock.unlock();
+        drainAll();
+        lock.lock();
+      }
+    }
+
+    // Guards queues, producers only take it once to register
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<LogQueue>> queues;
+
+    // Serializes the consumers, guards everything below
+    std::mutex drainMutex;
+    std::vector<LogRecord> batch;
+    std::string output;
+    uint64_t reportedDrops{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    bool wakeRequested{false};
+    bool running{true};
+
+    std::thread writer;
+  };
+
+  // Constant initialized so statements in static destructors see it after the backend is gone
+  std::atomic<bool> backendAlive{false};
+
+  Backend *getBackend() {
+    static struct Holder {
+      Backend backend{};
+      Holder() { backendAlive = true; }
+      ~Holder() { backendAlive = false; }
+    } holder{};
+    return backendAlive ? &holder.backend : nullptr;
+  }
+
+  struct QueueHandle {
+    std::shared_ptr<LogQueue> queue;
+
+    ~QueueHandle() {
+      if (queue != nullptr) queue->abandoned = true;
+    }
+  };
+
+  void writeNow(LogRecord &record) {
+    std::string line;
+    appendLine(line, record);
+    std::cout << line << std::flush;
+  }
+
+  /**
+   *  @brief Queues the record. Fatal records and everything logged after the backend was destroyed are written
+   *  right away.
+   **/
+  void push(LogRecord &&record) {
+    Backend *backend = getBackend();
+    if (backend == nullptr || record.severity == Severity::F) {
+      // Everything before it should make it out as well
+      if (backend != nullptr) backend->drainAll();
+      writeNow(record);
+      if (record.severity == Severity::F) abort();
+      return;
+    }
+
+    thread_local QueueHandle handle{backend->registerQueue()};
+    record.sequence = backend->nextSequence.fetch_add(1, std::memory_order_relaxed);
+    const Severity severity = record.severity;
+    if (!handle.queue->push(std::move(record))) {
+      backend->droppedMessages.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // A burst would fill the queue before the writer wakes up on its own
+    if (severity == Severity::E || handle.queue->size() == LOG_QUEUE_SIZE / 2) backend->wake();
+  }
+
+}
+
+void backend::submit(Severity severity, std::string &&message) {
+  LogRecord record{};
+  record.severity = severity;
+  record.text = std::move(message);
+  push(std::move(record));
+}
+
+void backend::submitDeferred(Severity severity, const char *file, int line, DeferredFormatter formatter,
+                             const char *format, const uint8_t *args, size_t argsSize) {
+  LogRecord record{};
+  record.severity = severity;
+  record.formatter = formatter;
+  record.format = format;
+  record.file = file;
+  record.line = line;
+  std::memcpy(record.args, args, std::min(argsSize, DEFERRED_ARGS_SIZE));
+  push(std::move(record));
+}
+
+void backend::flush() {
+  if (Backend *backend = getBackend()) backend->drainAll();
+}
+
+uint64_t backend::getDroppedMessages() {
+  Backend *backend = getBackend();
+  return backend != nullptr ? backend->droppedMessages.load() : 0;
+}
+
+/**
+ *  @brief Parses comma separated module=severity pairs, * sets every module. Unknown entries are skipped with a
+ *  warning. Levels below VOXLE_LOG_MIN_SEVERITY have no effect, those statements aren't compiled in.
+ **/
+void applyLevelsFromEnvironment() {
+  const char *variable = std::getenv("VOXLE_LOG_LEVELS");
+  if (variable == nullptr) return;
+
+  static const std::pair<const char *, Module> modules[] = {
+    {"core", Module::CORE}, {"render", Module::RENDER}, {"world", Module::WORLD},
+    {"threading", Module::THREADING}, {"resource", Module::RESOURCE}, {"ui", Module::UI}
+  };
+  static const char severities[] = "DIWEF";
+
+  std::stringstream entries(variable);
+  std::string entry;
+  while (std::getline(entries, entry, ',')) {
+    const size_t separator = entry.find('=');
+    const char *severityEnd = separator != std::string::npos && separator + 2 == entry.size()
+                              ? std::strchr(severities, std::toupper(static_cast<unsigned char>(entry.back())))
+                              : nullptr;
+    if (severityEnd == nullptr) {
+      LOG(W, "Skipping log level '" << entry << "', expected module=D|I|W|E|F");
+      continue;
+    }
+    const auto severity = static_cast<Severity>(severityEnd - severities);
+    const std::string name = entry.substr(0, separator);
+
+    bool known = false;
+    for (const auto &[moduleName, module]: modules) {
+      if (name != "*" && name != moduleName) continue;
+      setModuleLevel(module, severity);
+      known = true;
+    }
+    if (!known) LOG(W, "Skipping log level of unknown module '" << name << "'");
+  }
+}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace voxle::logging {
+enum class Severity { D, I, W, E, F };
+
+// Every statement belongs to the module of the engine directory its file is in
+enum class Module { CORE, RENDER, WORLD, THREADING, RESOURCE, UI, COUNT };
+
+// Bytes of arguments a deferred log statement can carry
+inline const size_t DEFERRED_ARGS_SIZE = 64;
+// Unwritten messages each thread can hold, messages logged while its queue is full are dropped
+inline const size_t LOG_QUEUE_SIZE = 1024;
+
+// Formats the packed arguments of a deferred statement into out
+using DeferredFormatter = void (*)(const char *format, const uint8_t *args, std::string &out);
+
+/**
+ *  @brief Asynchronous sink of the LOG macros.
+ *  Every thread pushes its messages into its own queue without taking a lock, a background writer drains all
+ *  queues in the order the messages were logged and writes them in batches. A thread that logs never waits for
+ *  the console, a full queue drops the message instead and the writer reports how many were dropped.
+ *  Errors wake the writer right away, fatal messages are written synchronously before aborting.
+ **/
+namespace backend {
+  void submit(Severity severity, std::string &&message);
+  // Stores the format and the packed arguments, the writer thread formats them
+  void submitDeferred(Severity severity, const char *file, int line, DeferredFormatter formatter, const char *format,
+                      const uint8_t *args, size_t argsSize);
+
+  // Writes every message logged so far before returning
+  void flush();
+
+  [[nodiscard]] uint64_t getDroppedMessages();
+}
+
+// Sets the module levels from VOXLE_LOG_LEVELS, for example "world=W,render=D" or "*=E"
+void applyLevelsFromEnvironment();
+}
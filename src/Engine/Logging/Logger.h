@@ -1,6 +1,12 @@
 #pragma once
+#include "LogBackend.hpp"
+
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -8,6 +14,8 @@
 #include <utility>
 #include <set>
 #include <sstream>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 
 //! Debug flag, If VOXLE_DEBUG_LOGGING is enabled, debug output should be printed.
@@ -15,11 +23,18 @@
 #define VOXLE_DEBUG_LOGGING
 #endif
 
-#define VOXLE_GET_KEY() std::string(__FILE__) + ":" + std::to_string(__LINE__)
+//! Lowest severity that is compiled in at all (0 = D ... 4 = F), statements below it compile to nothing and never
+//! evaluate their arguments. Fatal statements are always compiled in.
+#ifndef VOXLE_LOG_MIN_SEVERITY
+#ifdef VOXLE_DEBUG_LOGGING
+#define VOXLE_LOG_MIN_SEVERITY 0
+#else
+#define VOXLE_LOG_MIN_SEVERITY 1
+#endif
+#endif
+
 #define VOXLE_LOGPREFIX voxle::logging::getFileName(__FILE__) << ":" << __LINE__ << " "
 namespace voxle::logging {
-enum class Severity { D, I, W, E, F };
-
 // Constexpr function to extract just the file name from the full path
 inline static constexpr const char* getFileName(const char* path) {
   const char* file = path;
@@ -35,8 +50,63 @@ inline static constexpr const char* getFileName(const char* path) {
   }
   return file;
 }
+
+// True if path has a directory called name
+inline constexpr bool hasDirectory(const char* path, const char* name) {
+  for (const char* segment = path; *segment; ++segment) {
+    if (segment != path && segment[-1] != '/' && segment[-1] != '\\') continue;
+    size_t i = 0;
+    while (name[i] && segment[i] == name[i]) ++i;
+    if (!name[i] && (segment[i] == '/' || segment[i] == '\\')) return true;
+  }
+  return false;
+}
+
+// Evaluated at compile time for every statement
+inline constexpr Module getModule(const char* path) {
+  if (hasDirectory(path, "World")) return Module::WORLD;
+  if (hasDirectory(path, "Renderer") || hasDirectory(path, "VulkanPipeline") || hasDirectory(path, "Shader")) {
+    return Module::RENDER;
+  }
+  if (hasDirectory(path, "Threading")) return Module::THREADING;
+  if (hasDirectory(path, "Resource")) return Module::RESOURCE;
+  if (hasDirectory(path, "UI")) return Module::UI;
+  return Module::CORE;
+}
+
+inline constexpr bool isCompiledIn(Severity severity) {
+  return severity == Severity::F || static_cast<int>(severity) >= VOXLE_LOG_MIN_SEVERITY;
+}
+
+static_assert(static_cast<int>(Module::COUNT) == 6, "Every module needs its level below");
+// Runtime minimum severity per module, a single relaxed load per statement
+inline std::atomic<int> moduleLevels[static_cast<int>(Module::COUNT)]{
+  VOXLE_LOG_MIN_SEVERITY, VOXLE_LOG_MIN_SEVERITY, VOXLE_LOG_MIN_SEVERITY,
+  VOXLE_LOG_MIN_SEVERITY, VOXLE_LOG_MIN_SEVERITY, VOXLE_LOG_MIN_SEVERITY
+};
+
+inline bool isModuleEnabled(Module module, Severity severity) {
+  return severity == Severity::F ||
+         static_cast<int>(severity) >= moduleLevels[static_cast<int>(module)].load(std::memory_order_relaxed);
+}
+
+// Can't go below VOXLE_LOG_MIN_SEVERITY, those statements aren't compiled in
+inline void setModuleLevel(Module module, Severity severity) {
+  moduleLevels[static_cast<int>(module)].store(static_cast<int>(severity), std::memory_order_relaxed);
+}
 }
 
+//! True if a statement of severity in this file would be logged, for work that only feeds log statements.
+//! The compile time part is a constant expression, statements below VOXLE_LOG_MIN_SEVERITY are dead code.
+#define LOG_ENABLED(severity)                                                                               \
+  (std::integral_constant<bool, voxle::logging::isCompiledIn(voxle::logging::Severity::severity)>::value && \
+   voxle::logging::isModuleEnabled(                                                                         \
+     std::integral_constant<voxle::logging::Module, voxle::logging::getModule(__FILE__)>::value,            \
+     voxle::logging::Severity::severity))
+
+//! Statements are conditional expressions rather than if statements, so an unbraced if around them keeps its else
+#define VOXLE_LOG_IF(enabled) !(enabled) ? (void) 0 : voxle::logging::LogVoidify() &
+
 //! Hack to enable macro overloading. Used to overload LOG() macro.
 #define CAT(A, B) A##B
 #define SELECT(NAME, NUM) CAT(NAME##_, NUM)
@@ -48,53 +118,46 @@ inline static constexpr const char* getFileName(const char* path) {
 //! Overloads
 #define LOG(...) VA_SELECT(LOG, __VA_ARGS__)
 
-#define LOG_EVERY(severity, n, x) voxle::logging::InternalLogCount::getInstance().update(                       \
-      VOXLE_GET_KEY(), n, voxle::logging::InternalLog() << VOXLE_LOGPREFIX << x, voxle::logging::Severity::severity, voxle::logging::PolicyType::EVERY_N) // NOLINT(bugprone-macro-parentheses)
-#define LOG_FIRST(severity, n, x) voxle::logging::InternalLogCount::getInstance().update(                       \
-      VOXLE_GET_KEY(), n, voxle::logging::InternalLog() << VOXLE_LOGPREFIX << x, voxle::logging::Severity::severity, voxle::logging::PolicyType::FIRST_N) // NOLINT(bugprone-macro-parentheses)
-#define LOG_TIMED(severity, n, x) voxle::logging::InternalLogCount::getInstance().update(                       \
-      VOXLE_GET_KEY(), n, voxle::logging::InternalLog() << VOXLE_LOGPREFIX << x, voxle::logging::Severity::severity, voxle::logging::PolicyType::TIMED) // NOLINT(bugprone-macro-parentheses)
+//! Rate limited statements, the message is only built when it gets logged
+#define VOXLE_LOG_POLICY(policy, severity, n, x) do {                                               \
+    if (LOG_ENABLED(severity)) {                                                                    \
+      static voxle::logging::RateLimit voxleRateLimit{voxle::logging::PolicyType::policy, n};       \
+      if (voxleRateLimit.shouldLog()) LOG_2(severity, x);                                           \
+    }                                                                                               \
+  } while (false)
+#define LOG_EVERY(severity, n, x) VOXLE_LOG_POLICY(EVERY_N, severity, n, x)
+#define LOG_FIRST(severity, n, x) VOXLE_LOG_POLICY(FIRST_N, severity, n, x)
+#define LOG_TIMED(severity, n, x) VOXLE_LOG_POLICY(TIMED, severity, n, x)
+
+//! printf style statement that is formatted on the writer thread, the arguments have to be numbers or pointers to
+//! static data such as string literals
+#define LOGF(severity, ...)                                                                                 \
+  !LOG_ENABLED(severity) ? (void) 0                                                                         \
+                         : voxle::logging::logDeferred(voxle::logging::Severity::severity, __FILE__, __LINE__, \
+                                                       __VA_ARGS__)
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedMacroInspection"
-#define LOG_2(severity, x) voxle::logging::InternalLog(voxle::logging::Severity::severity) << VOXLE_LOGPREFIX << x // NOLINT(bugprone-macro-parentheses)
-#define LOG_3(severity, cond, x) if (cond) voxle::logging::InternalLog(voxle::logging::Severity::severity) << VOXLE_LOGPREFIX << x // NOLINT(bugprone-macro-parentheses)
+#define LOG_2(severity, x) VOXLE_LOG_IF(LOG_ENABLED(severity)) voxle::logging::InternalLog(voxle::logging::Severity::severity) << VOXLE_LOGPREFIX << x // NOLINT(bugprone-macro-parentheses)
+#define LOG_3(severity, cond, x) VOXLE_LOG_IF(LOG_ENABLED(severity) && (cond)) voxle::logging::InternalLog(voxle::logging::Severity::severity) << VOXLE_LOGPREFIX << x // NOLINT(bugprone-macro-parentheses)
 #pragma clang diagnostic pop
 
 namespace voxle::logging {
 struct Logging {
-  inline static void call(Severity severity, const std::string& str) {
-    switch (severity) {
-    case Severity::D:
-#ifdef VOXLE_DEBUG_LOGGING
-      std::cout << "\x1B[32m[DEBUG] " << str << "\033[0m" << std::endl;
-#endif
-      return;
-    case Severity::I:
-      std::cout << "\x1B[37m[INFO ] " << str << "\033[0m" << std::endl;
-      return;
-    case Severity::W:
-      std::cout << "\x1B[33m[WARN ] " << str << std::endl;
-      return;
-    case Severity::E:
-      std::cout << "\x1B[31m[ERROR] " << str << std::endl;
-      return;
-    case Severity::F:
-      std::cout << "\x1B[91m[FATAL] " << str << "\033[0m" << std::endl;
-      abort();
-    }
+  inline static void call(Severity severity, std::string &&str) {
+    backend::submit(severity, std::move(str));
   }
 };
 
 //! Composes a string with the same text that would be printed if format was used on printf(3)
 template <typename... Args>
 inline std::string formatToString(const char *f, Args... args) {
-  size_t sz = snprintf(nullptr, 0, f, args...);
-  if (sz == 0) {
+  const int sz = snprintf(nullptr, 0, f, args...);
+  if (sz <= 0) {
     return "";
   }
-  char *buf = (char *)malloc(sz + 1);
-  snprintf(buf, sz + 1, f, args...);
+  std::string buf(static_cast<size_t>(sz), '\0');
+  snprintf(buf.data(), buf.size() + 1, f, args...);
   return buf;
 }
 
@@ -125,215 +188,88 @@ protected:
   bool should_print_{true};
 };
 
+// Turns a statement into void so it matches the other branch of VOXLE_LOG_IF, binds weaker than <<
+struct LogVoidify {
+  template <typename T>
+  void operator&(T &&) const {}
+};
+
 template <typename T>
 InternalLog &&operator<<(InternalLog &&wrap, T const &whatever) {
   wrap.ss << whatever;
   return std::move(wrap);
 }
 
-class LogPolicy {
-public:
-  virtual void update() = 0;
-  [[nodiscard]] virtual bool shouldLog() const = 0;
-  virtual void onLog(){};
-  virtual ~LogPolicy() = default;
-
-protected:
-  explicit LogPolicy(int max) : max_(max) {}
-  int counter_{0};
-  int max_{0};
-};
-
-class OccasionPolicy : public LogPolicy {
-public:
-  explicit OccasionPolicy(int max) : LogPolicy(max) { counter_ = max_; }
-
-  inline void update() override {
-    should_log_ = false;
-
-    if (counter_ % max_ == 0) {
-      should_log_ = true;
-      counter_ = 0;
-    }
-    counter_++;
-  }
-
-  [[nodiscard]] inline bool shouldLog() const override { return should_log_; }
-
-private:
-  bool should_log_{false};
-};
-
-class FirstNOccurrencesPolicy : public LogPolicy {
-public:
-  explicit FirstNOccurrencesPolicy(int max) : LogPolicy(max) {}
-  inline void update() override {
-    if (!is_n_occurences_reached) {
-      counter_++;
-    }
-
-    if (counter_ > max_) {
-      is_n_occurences_reached = true;
-    }
-  }
-
-  [[nodiscard]] inline bool shouldLog() const override {
-    return !is_n_occurences_reached;
-  }
-
-private:
-  bool is_n_occurences_reached = false;
-};
-
-using namespace std::chrono;
-
-class TimePolicy : public LogPolicy {
-public:
-  explicit TimePolicy(int max) : LogPolicy(max){};
-
-  inline void update() override {
-    now_ = duration_cast<microseconds>(system_clock::now().time_since_epoch())
-               .count();
-  }
-
-  [[nodiscard]] inline bool shouldLog() const override {
-    if (now_ >= last_ + (max_ * 1000000)) {
-      return true;
-    }
-    return false;
-  }
-
-  void onLog() override { last_ = now_; }
-
-private:
-  long now_{0};
-  long last_{0};
-};
-
 enum PolicyType { FIRST_N, EVERY_N, TIMED };
 
-typedef std::shared_ptr<LogPolicy> LogPolicyPtr;
-
-class LogPolicyFactory {
+//! State of a single rate limited log statement, lives in a static at the call site so no lookup or lock is needed
+class RateLimit {
 public:
-  static LogPolicyPtr create(PolicyType policy_type, int max) {
-    switch (policy_type) {
+  RateLimit(PolicyType policy_type, int max) : policy_type_(policy_type), max_(std::max(max, 1)) {}
+
+  inline bool shouldLog() {
+    switch (policy_type_) {
     case FIRST_N:
-      return std::make_shared<FirstNOccurrencesPolicy>(max);
+      // Stops counting once reached so the counter can't wrap around
+      if (counter_.load(std::memory_order_relaxed) >= static_cast<uint64_t>(max_)) {
+        return false;
+      }
+      return counter_.fetch_add(1, std::memory_order_relaxed) < static_cast<uint64_t>(max_);
     case EVERY_N:
-      return std::make_shared<OccasionPolicy>(max);
-    case TIMED:
-      return std::make_shared<TimePolicy>(max);
-    default:
-      abort();
+      return counter_.fetch_add(1, std::memory_order_relaxed) % static_cast<uint64_t>(max_) == 0;
+    case TIMED: {
+      const auto now = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+      int64_t last = last_.load(std::memory_order_relaxed);
+      if (last != 0 && now < last + static_cast<int64_t>(max_) * 1000000) {
+        return false;
+      }
+      // Only one of the threads hitting it at the same time logs
+      return last_.compare_exchange_strong(last, now, std::memory_order_relaxed);
     }
-  }
-};
-
-struct LogStatementData {
-  LogStatementData(LogPolicyPtr log_policy, Severity severity_type)
-      : log_policy_(std::move(log_policy)), severity_type_(severity_type) {}
-  LogPolicyPtr log_policy_;
-  std::string msg{};
-  Severity severity_type_;
-};
-
-class InternalLogCount {
-public:
-  static InternalLogCount &getInstance() {
-    static InternalLogCount instance;
-    return instance;
-  }
-
-  inline void update(const std::string &key, int max,
-                     const InternalLog &internal_log,
-                     const Severity base_severity, PolicyType policy_type) {
-    update(key, max, internal_log.ss.str(), base_severity, policy_type);
-  }
-
-  inline void update(const std::string &key, int max,
-                     const std::string &log_msg,
-                     const Severity base_severity, PolicyType policy_type) {
-
-    updatePolicy(key, max, log_msg, base_severity, policy_type);
-    mtx_.lock();
-    logIfReady(key, log_msg);
-    mtx_.unlock();
-  }
-
-  inline void updatePolicy(const std::string &key, int max,
-                           const std::string &log_msg,
-                           Severity base_severity, PolicyType policy_type) {
-    mtx_.lock();
-    if (!keyExists(key)) {
-      LogStatementData data(LogPolicyFactory::create(policy_type, max),
-                            base_severity);
-      data.msg = log_msg;
-      updateLogPolicyData(&data);
-      occurences_.insert({key, data});
-    } else {
-      LogStatementData *data = &occurences_.at(key);
-      updateLogPolicyData(data);
     }
-    mtx_.unlock();
-  }
-
-  inline bool shouldLog(const std::string &key) {
-    mtx_.lock();
-    bool res = occurences_.at(key).log_policy_->shouldLog();
-    mtx_.unlock();
-    return res;
-  }
-
-  inline void log(const std::string &key) {
-    mtx_.lock();
-    occurences_.at(key).log_policy_->onLog();
-    mtx_.unlock();
+    return false;
   }
 
 private:
-  inline bool keyExists(const std::string &key) {
-    return occurences_.find(key) != occurences_.end();
-  }
-
-  static inline void updateLogPolicyData(LogStatementData *data) {
-    data->log_policy_->update();
-  }
-
-  inline void logIfReady(const std::string &key, const std::string &log_msg) {
-    LogStatementData *data = &occurences_.at(key);
-    if (data->log_policy_->shouldLog()) {
-      data->log_policy_->onLog();
-      data->msg = log_msg;
-      InternalLog(data->severity_type_) << data->msg;
-    }
-  }
-
-  InternalLogCount() = default;
-  std::unordered_map<std::string, LogStatementData> occurences_{};
-  std::mutex mtx_{};
+  PolicyType policy_type_;
+  int max_;
+  std::atomic<uint64_t> counter_{0};
+  std::atomic<int64_t> last_{0};
 };
 
+//! Deferred statements copy their arguments as raw bytes, the writer thread formats them
+template <typename T>
+inline void packDeferredArg(uint8_t *out, size_t &offset, const T &value) {
+  std::memcpy(out + offset, &value, sizeof(T));
+  offset += sizeof(T);
+}
 
-class InternalPolicyLog : public InternalLog {
-public:
-  InternalPolicyLog(std::string key, int n, Severity base_severity,
-                    PolicyType policy_type)
-      : key_(std::move(key)), n_(n), policy_type_(policy_type),
-        InternalLog(base_severity) {
-    should_print_ = false;
-  };
-
-  ~InternalPolicyLog() override {
-    if (should_update_) {
-      InternalLogCount::getInstance().update(key_, n_, ss.str(), severity_, policy_type_);
-    }
-  }
+template <typename T>
+inline T unpackDeferredArg(const uint8_t *in, size_t &offset) {
+  T value;
+  std::memcpy(&value, in + offset, sizeof(T));
+  offset += sizeof(T);
+  return value;
+}
 
-protected:
-  bool should_update_{true};
-  std::string key_{};
-  int n_{};
-  PolicyType policy_type_{};
-};
+template <typename... Args>
+void formatDeferred(const char *format, [[maybe_unused]] const uint8_t *args, std::string &out) {
+  [[maybe_unused]] size_t offset = 0;
+  // Braced initialization unpacks the arguments in order
+  const std::tuple<Args...> values{unpackDeferredArg<Args>(args, offset)...};
+  out += std::apply([format](auto... unpacked) { return formatToString(format, unpacked...); }, values);
+}
+
+template <typename... Args>
+inline void logDeferred(Severity severity, const char *file, int line, const char *format, Args... args) {
+  static_assert(((std::is_arithmetic_v<Args> || std::is_pointer_v<Args>) && ...),
+                "LOGF only takes numbers and pointers to data that outlives the program, use LOG for anything else");
+  static_assert((sizeof(Args) + ... + 0) <= DEFERRED_ARGS_SIZE, "Too many arguments for LOGF");
+
+  uint8_t packed[DEFERRED_ARGS_SIZE];
+  size_t offset = 0;
+  (packDeferredArg(packed, offset, args), ...);
+  backend::submitDeferred(severity, file, line, &formatDeferred<Args...>, format, packed, offset);
+}
 }
@@ -0,0 +1,218 @@
+#include "Profiler.hpp"
+
+#include <Logging/Logger.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+  struct Event {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+  };
+
+  struct EventCopy {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+  };
+
+  /**
+   *  @brief Ring of zones written by a single thread. Readers copy it and drop whatever got overwritten meanwhile.
+   **/
+  struct ThreadBuffer {
+    uint32_t id = 0;
+    // Guarded by registryMutex
+    std::string name;
+    // Zones written so far, the slot of a zone is its index modulo RING_SIZE
+    std::atomic<uint64_t> head{0};
+    std::unique_ptr<Event[]> events = std::make_unique<Event[]>(Profiler::RING_SIZE);
+
+    void record(const char *zoneName, uint64_t start, uint64_t end) {
+      const uint64_t index = head.load(std::memory_order_relaxed);
+      Event &event = events[index % Profiler::RING_SIZE];
+      event.name.store(zoneName, std::memory_order_relaxed);
+      event.start.store(start, std::memory_order_relaxed);
+      event.end.store(end, std::memory_order_relaxed);
+      head.store(index + 1, std::memory_order_release);
+    }
+
+    std::vector<EventCopy> snapshot() const {
+      const uint64_t first = head.load(std::memory_order_acquire);
+      const uint64_t begin = first > Profiler::RING_SIZE ? first - Profiler::RING_SIZE : 0;
+
+      std::vector<EventCopy> copies;
+      copies.reserve(first - begin);
+      for (uint64_t i = begin; i < first; ++i) {
+        const Event &event = events[i % Profiler::RING_SIZE];
+        copies.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                          event.end.load(std::memory_order_relaxed)});
+      }
+
+      // The writer might be overwriting the slot after the last published zone as well
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t last = head.load(std::memory_order_relaxed) + 1;
+      const uint64_t valid = last > Profiler::RING_SIZE ? last - Profiler::RING_SIZE : 0;
+      const auto overwritten = static_cast<ptrdiff_t>(std::min<uint64_t>(valid > begin ? valid - begin : 0,
+                                                                         copies.size()));
+      copies.erase(copies.begin(), copies.begin() + overwritten);
+      return copies;
+    }
+  };
+
+  std::mutex registryMutex;
+  // Buffers outlive their threads so the trace still has the zones of stopped workers
+  std::vector<std::shared_ptr<ThreadBuffer>> registry;
+  uint32_t nextThreadId = 1;
+
+  std::shared_ptr<ThreadBuffer> registerBuffer(const std::string &name) {
+    auto buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->id = nextThreadId++;
+    buffer->name = name.empty() ? "Thread " + std::to_string(buffer->id) : name;
+    registry.push_back(buffer);
+    return buffer;
+  }
+
+  ThreadBuffer &getThreadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = registerBuffer("");
+    return *buffer;
+  }
+
+  ThreadBuffer &getGpuBuffer() {
+    static std::shared_ptr<ThreadBuffer> buffer = registerBuffer("GPU");
+    return *buffer;
+  }
+
+  // Main thread only
+  std::array<float, Profiler::FRAME_HISTORY> frameTimes{};
+  size_t frameCount = 0;
+  uint64_t lastFrame = 0;
+
+  void writeEscaped(std::ostream &out, const char *text) {
+    for (const char *c = text; *c != '\0'; ++c) {
+      if (*c == '"' || *c == '\\') out << '\\';
+      out << *c;
+    }
+  }
+
+}
+
+Profiler::Zone::Zone(const char *name) : name(name), start(now()) {}
+
+Profiler::Zone::~Zone() {
+  getThreadBuffer().record(name, start, now());
+}
+
+uint64_t Profiler::now() {
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::setThreadName(const std::string &name) {
+  ThreadBuffer &buffer = getThreadBuffer();
+  std::lock_guard<std::mutex> lock(registryMutex);
+  buffer.name = name;
+}
+
+void Profiler::recordGpuZone(const char *name, uint64_t startNs, uint64_t endNs) {
+  getGpuBuffer().record(name, startNs, endNs);
+}
+
+/**
+ *  @brief Ends the current frame, it also shows up as a zone in the trace.
+ **/
+void Profiler::markFrame() {
+  const uint64_t time = now();
+  if (lastFrame != 0) {
+    frameTimes[frameCount % FRAME_HISTORY] = static_cast<float>(time - lastFrame) / 1000000.0f;
+    frameCount++;
+    getThreadBuffer().record("frame", lastFrame, time);
+  }
+  lastFrame = time;
+}
+
+Profiler::FrameStats Profiler::getFrameStats() {
+  FrameStats stats{};
+  stats.frames = std::min(frameCount, FRAME_HISTORY);
+  if (stats.frames == 0) return stats;
+
+  std::vector<float> sorted(frameTimes.begin(), frameTimes.begin() + static_cast<ptrdiff_t>(stats.frames));
+  std::sort(sorted.begin(), sorted.end());
+
+  float sum = 0.0f;
+  for (float time: sorted) sum += time;
+  stats.p50Ms = sorted[sorted.size() / 2];
+  stats.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+  stats.maxMs = sorted.back();
+  stats.meanMs = sum / static_cast<float>(sorted.size());
+  return stats;
+}
+
+std::vector<float> Profiler::getFrameHistogram(float binMs, size_t binCount) {
+  std::vector<float> bins(binCount, 0.0f);
+  if (binCount == 0 || binMs <= 0.0f) return bins;
+
+  const size_t frames = std::min(frameCount, FRAME_HISTORY);
+  for (size_t i = 0; i < frames; ++i) {
+    const auto bin = static_cast<size_t>(frameTimes[i] / binMs);
+    bins[std::min(bin, binCount - 1)] += 1.0f;
+  }
+  return bins;
+}
+
+/**
+ *  @brief Writes the zones every ring still holds as Chrome trace JSON, one track per thread and one for the gpu.
+ **/
+bool Profiler::exportTrace(const std::string &path) {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffers = registry;
+    for (const auto &buffer: registry) names.push_back(buffer->name);
+  }
+
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    LOG(E, "Failed to open " << path << " for the trace");
+    return false;
+  }
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out.setf(std::ios::fixed);
+  out.precision(3);
+
+  size_t zones = 0;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    out << (i == 0 ? "" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffers[i]->id
+        << R"(,"args":{"name":")";
+    writeEscaped(out, names[i].c_str());
+    out << "\"}}";
+
+    for (const EventCopy &event: buffers[i]->snapshot()) {
+      if (event.name == nullptr || event.end < event.start) continue;
+      out << ",\n{\"name\":\"";
+      writeEscaped(out, event.name);
+      out << R"(","ph":"X","pid":1,"tid":)" << buffers[i]->id << ",\"ts\":" << event.start / 1000.0
+          << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+      zones++;
+    }
+  }
+  out << "\n]}\n";
+
+  if (!out) {
+    LOG(E, "Failed to write the trace to " << path);
+    return false;
+  }
+  LOG(I, "Wrote " << zones << " zones to " << path);
+  return true;
+}
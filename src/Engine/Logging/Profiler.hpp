@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope, name has to be a string literal
+#define PROFILE_ZONE(name) const Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__){name}
+
+/**
+ *  @brief Scoped cpu zones and frame times.
+ *  Every thread records its zones into its own ring buffer without locks, the newest events overwrite the oldest.
+ *  exportTrace writes what the rings still hold as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+ *  Frame times are kept separately for the percentiles and the histogram in the overlay.
+ **/
+namespace Profiler {
+
+  // Zones each thread keeps, older ones are overwritten
+  inline const size_t RING_SIZE = 8192;
+  // Frames the frame time statistics are computed over
+  inline const size_t FRAME_HISTORY = 512;
+
+  struct FrameStats {
+    float p50Ms = 0.0f;
+    float p99Ms = 0.0f;
+    float maxMs = 0.0f;
+    float meanMs = 0.0f;
+    size_t frames = 0;
+  };
+
+  /**
+   *  @brief Records the time between its construction and destruction as a zone of the calling thread.
+   **/
+  class Zone {
+  public:
+    explicit Zone(const char *name);
+    ~Zone();
+
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+  private:
+    const char *name;
+    uint64_t start;
+  };
+
+  // Nanoseconds since the profiler was first used
+  uint64_t now();
+
+  void setThreadName(const std::string &name);
+
+  // Zone that was timed elsewhere, for the gpu timestamps. Only the render thread may call this
+  void recordGpuZone(const char *name, uint64_t startNs, uint64_t endNs);
+
+  // Called once per frame by the main thread, the time since the last call is the frame time
+  void markFrame();
+  FrameStats getFrameStats();
+  // Number of frames per bin of binMs milliseconds, the last bin holds every slower frame as well
+  std::vector<float> getFrameHistogram(float binMs, size_t binCount);
+
+  bool exportTrace(const std::string &path);
+}
@@ -0,0 +1,85 @@
+#include "CaveCuller.h"
+
+#include "World/VoxelAccess.hpp"
+
+void CaveCuller::setChunk(const glm::ivec3 &pos, const ChunkVisibility &visibility) {
+  visibilities[pos] = visibility;
+}
+
+void CaveCuller::removeChunk(const glm::ivec3 &pos) {
+  visibilities.erase(pos);
+}
+
+void CaveCuller::setRange(int horizontal, int vertical) {
+  rangeHorizontal = horizontal;
+  rangeVertical = vertical;
+}
+
+/**
+ *  @brief Breadth first search from the camera chunk. A neighbour is entered if the current chunk connects the face
+ *  the search came in through with the face towards it and the neighbour is inside the frustum. Chunks without
+ *  visibility data yet count as open.
+ **/
+void CaveCuller::update(const glm::vec3 &cameraPos, const Frustum &frustum) {
+  const glm::ivec3 cameraChunk = glm::floor(cameraPos / static_cast<float>(CHUNK_SIZE));
+
+  gridSize = {rangeHorizontal * 2 + 1, rangeVertical * 2 + 1, rangeHorizontal * 2 + 1};
+  gridOrigin = cameraChunk - glm::ivec3{rangeHorizontal, rangeVertical, rangeHorizontal};
+  reached.assign(static_cast<size_t>(gridSize.x) * gridSize.y * gridSize.z, 0);
+
+  queue.clear();
+  queue.push_back({cameraChunk, -1, 0});
+  reached[getGridIndex(cameraChunk)] = 1;
+
+  const float halfChunk = static_cast<float>(CHUNK_SIZE) * 0.5f;
+
+  // The queue only grows, so it doubles as the list of visited chunks
+  for (size_t i = 0; i < queue.size(); ++i) {
+    const Node node = queue[i];
+
+    auto found = visibilities.find(node.pos);
+    const ChunkVisibility visibility = found != visibilities.end() ? found->second : ChunkVisibility::open();
+
+    for (int dir = 0; dir < 6; ++dir) {
+      const auto direction = static_cast<Direction>(dir);
+      const Direction opposite = getOppositeDirection(direction);
+
+      if (node.travelled & (1u << static_cast<int>(opposite))) continue;
+      if (node.entryFace >= 0 && !visibility.canSee(static_cast<Direction>(node.entryFace), direction)) continue;
+
+      const glm::ivec3 next = node.pos + directionOffsets[dir];
+      const int index = getGridIndex(next);
+      if (index < 0 || reached[index]) continue;
+
+      const glm::vec3 center = glm::vec3(next) * static_cast<float>(CHUNK_SIZE) + halfChunk;
+      if (!frustum.isVisible(AABB{Point{center.x, center.y, center.z}, Point{halfChunk, halfChunk, halfChunk}})) {
+        continue;
+      }
+
+      reached[index] = 1;
+      queue.push_back({next, static_cast<int>(opposite), node.travelled | (1u << dir)});
+    }
+  }
+
+  visitedChunks = static_cast<uint32_t>(queue.size());
+}
+
+/**
+ *  @brief Chunks outside of the searched range are never judged and always count as reachable.
+ **/
+bool CaveCuller::isReachable(const glm::ivec3 &pos) const {
+  const int index = getGridIndex(pos);
+  return index < 0 || reached[index];
+}
+
+/**
+ *  @brief Index into reached or -1 if pos is out of range.
+ **/
+int CaveCuller::getGridIndex(const glm::ivec3 &pos) const {
+  const glm::ivec3 local = pos - gridOrigin;
+  if (local.x < 0 || local.y < 0 || local.z < 0 || local.x >= gridSize.x || local.y >= gridSize.y ||
+      local.z >= gridSize.z) {
+    return -1;
+  }
+  return local.x + local.y * gridSize.x + local.z * gridSize.x * gridSize.y;
+}
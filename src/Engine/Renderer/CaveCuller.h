@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "World/ChunkMap.hpp"
+#include "World/ChunkVisibility.hpp"
+#include "Collision/Frustum.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+/**
+ *  @brief Walks outward from the camera chunk through the faces the chunk visibility connects and marks every chunk
+ *  it reaches. Chunks that can't be reached are hidden behind solid terrain. Runs on the cpu, no gpu readback needed.
+ **/
+class CaveCuller {
+public:
+  void setChunk(const glm::ivec3 &pos, const ChunkVisibility &visibility);
+  void removeChunk(const glm::ivec3 &pos);
+
+  // Chunks around the camera the search may visit, in chunks
+  void setRange(int horizontal, int vertical);
+
+  void update(const glm::vec3 &cameraPos, const Frustum &frustum);
+  [[nodiscard]] bool isReachable(const glm::ivec3 &pos) const;
+
+  void setEnabled(bool enable) { enabled = enable; }
+  [[nodiscard]] bool isEnabled() const { return enabled; }
+
+  [[nodiscard]] uint32_t getVisitedChunks() const { return visitedChunks; }
+
+private:
+  struct Node {
+    glm::ivec3 pos;
+    // Face the search entered through, -1 for the camera chunk
+    int entryFace;
+    // Directions taken so far, the search never turns back against one of them
+    uint32_t travelled;
+  };
+
+  [[nodiscard]] int getGridIndex(const glm::ivec3 &pos) const;
+
+  std::unordered_map<glm::ivec3, ChunkVisibility, ChunkPosHash> visibilities;
+
+  // Reached flags of the chunks in range, origin is the lowest corner
+  std::vector<uint8_t> reached;
+  glm::ivec3 gridOrigin{0};
+  glm::ivec3 gridSize{0};
+  int rangeHorizontal{8};
+  int rangeVertical{4};
+
+  std::vector<Node> queue;
+  uint32_t visitedChunks{0};
+
+  bool enabled{true};
+};
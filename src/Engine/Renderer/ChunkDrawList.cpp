@@ -0,0 +1,181 @@
+#include "ChunkDrawList.h"
+
+#include "Engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ *  @brief Creates the buffers of every frame and binds them to binding 2 of the frames descriptor set.
+ *  STAGE: After the descriptor sets
+ **/
+void ChunkDrawList::init(uint32_t frameCount, uint32_t capacity) {
+  frames.resize(frameCount);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    createFrameBuffers(frame, capacity);
+  }
+}
+
+void ChunkDrawList::destroy() {
+  for (uint32_t frame = 0; frame < frames.size(); ++frame) {
+    destroyFrameBuffers(frame);
+  }
+  frames.clear();
+}
+
+/**
+ *  @brief Writes a draw for every arena mesh inside the frustum into the buffers of the frame and returns the amount
+ *  of draws. With a caveCuller chunks it couldn't reach are skipped as well. The frame must not be in flight anymore.
+ **/
+uint32_t ChunkDrawList::build(uint32_t frame, const std::vector<Mesh> &meshes, const Frustum &frustum,
+                              const CaveCuller *caveCuller) {
+  const MeshArena &arena = EngineData::i()->vkInstWrapper.chunkArena;
+
+  candidates.clear();
+  candidateBounds.clear();
+  caveCulledChunks = 0;
+  for (const Mesh &m: meshes) {
+    if (m.arenaHandle == MeshArena::INVALID_HANDLE) continue;
+    if (arena.get(m.arenaHandle).indexCount == 0) continue;
+
+    if (caveCuller != nullptr) {
+      const glm::vec3 offset = m.meshRenderData.transformMatrix[3];
+      const glm::ivec3 chunkPos = glm::round(offset / static_cast<float>(CHUNK_SIZE));
+      if (!caveCuller->isReachable(chunkPos)) {
+        caveCulledChunks++;
+        continue;
+      }
+    }
+
+    candidates.push_back(&m);
+    candidateBounds.push(m.bounds);
+  }
+
+  const uint32_t visibleCount = candidateBounds.cull(frustum, candidateVisible);
+  frustumCulledChunks = static_cast<uint32_t>(candidates.size()) - visibleCount;
+
+  commands.clear();
+  drawData.clear();
+
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (!candidateVisible[i]) continue;
+
+    const Mesh &m = *candidates[i];
+    const MeshAllocation &range = arena.get(m.arenaHandle);
+
+    VkDrawIndexedIndirectCommand command{};
+    command.indexCount = range.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = range.firstIndex;
+    command.vertexOffset = static_cast<int32_t>(range.firstVertex);
+    // The shader finds its ChunkDrawData through gl_InstanceIndex
+    command.firstInstance = static_cast<uint32_t>(commands.size());
+    commands.push_back(command);
+
+    drawData.push_back({m.meshRenderData.transformMatrix[3]});
+  }
+
+  const auto drawCount = static_cast<uint32_t>(commands.size());
+  drawnChunks = drawCount;
+  if (drawCount == 0) return 0;
+
+  reserve(frame, drawCount);
+  FrameBuffers &buffers = frames[frame];
+
+  VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
+  memcpy(buffers.commandsMapped, commands.data(), sizeof(VkDrawIndexedIndirectCommand) * drawCount);
+  memcpy(buffers.drawDataMapped, drawData.data(), sizeof(ChunkDrawData) * drawCount);
+  vmaFlushAllocation(allocator, buffers.commandBuffer.allocation, 0, VK_WHOLE_SIZE);
+  vmaFlushAllocation(allocator, buffers.drawDataBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+  return drawCount;
+}
+
+/**
+ *  @brief Records the draws of the last build. The arena buffers, pipeline and descriptor set have to be bound.
+ **/
+void ChunkDrawList::record(VkCommandBuffer cmdBuffer, uint32_t frame, uint32_t drawCount) const {
+  if (drawCount == 0) return;
+
+  const VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  // Without drawIndirectFirstInstance the gpu can't index the draw data, draw one by one instead
+  if (indirect && vki.drawIndirectFirstInstance) {
+    VkBuffer indirectBuffer = frames[frame].commandBuffer.buffer;
+    if (vki.multiDrawIndirect) {
+      vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, 0, drawCount, stride);
+    } else {
+      for (uint32_t i = 0; i < drawCount; ++i) {
+        vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, static_cast<VkDeviceSize>(i) * stride, 1, stride);
+      }
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < drawCount; ++i) {
+    const VkDrawIndexedIndirectCommand &command = commands[i];
+    vkCmdDrawIndexed(cmdBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset,
+                     command.firstInstance);
+  }
+}
+
+/**
+ *  @brief Grows the buffers of the frame to hold at least capacity draws. The frame must not be in flight.
+ **/
+void ChunkDrawList::reserve(uint32_t frame, uint32_t capacity) {
+  FrameBuffers &buffers = frames[frame];
+  if (capacity <= buffers.capacity) return;
+
+  uint32_t newCapacity = std::max(buffers.capacity, 1u);
+  while (newCapacity < capacity) newCapacity *= 2;
+  destroyFrameBuffers(frame);
+  createFrameBuffers(frame, newCapacity);
+}
+
+void ChunkDrawList::createFrameBuffers(uint32_t frame, uint32_t capacity) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  FrameBuffers &buffers = frames[frame];
+
+  // Storage usage so the gpu culling can write the draws itself
+  Buffers::createBufferVMA(sizeof(VkDrawIndexedIndirectCommand) * capacity,
+                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, buffers.commandBuffer.buffer,
+                           buffers.commandBuffer.allocation);
+  Buffers::createBufferVMA(sizeof(ChunkDrawData) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, buffers.drawDataBuffer.buffer,
+                           buffers.drawDataBuffer.allocation);
+
+  // Stays mapped until the buffers get destroyed
+  vmaMapMemory(vki.vmaAllocator, buffers.commandBuffer.allocation, &buffers.commandsMapped);
+  vmaMapMemory(vki.vmaAllocator, buffers.drawDataBuffer.allocation, &buffers.drawDataMapped);
+  buffers.capacity = capacity;
+
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffers.drawDataBuffer.buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = vki.descriptorSets[frame];
+  write.dstBinding = 2;
+  write.dstArrayElement = 0;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.descriptorCount = 1;
+  write.pBufferInfo = &bufferInfo;
+
+  vkUpdateDescriptorSets(vki.device, 1, &write, 0, nullptr);
+}
+
+void ChunkDrawList::destroyFrameBuffers(uint32_t frame) {
+  VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
+  FrameBuffers &buffers = frames[frame];
+  if (buffers.capacity == 0) return;
+
+  vmaUnmapMemory(allocator, buffers.commandBuffer.allocation);
+  vmaUnmapMemory(allocator, buffers.drawDataBuffer.allocation);
+  vmaDestroyBuffer(allocator, buffers.commandBuffer.buffer, buffers.commandBuffer.allocation);
+  vmaDestroyBuffer(allocator, buffers.drawDataBuffer.buffer, buffers.drawDataBuffer.allocation);
+  buffers = FrameBuffers{};
+}
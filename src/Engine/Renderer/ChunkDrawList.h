@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "VulkanPipeline/Pipeline/Buffer/Buffer.h"
+#include "Collision/Frustum.hpp"
+#include "CaveCuller.h"
+
+#include <vector>
+
+class Mesh;
+
+/**
+ *  @brief Per draw data read by the chunk vertex shader through gl_InstanceIndex.
+ **/
+struct ChunkDrawData {
+  glm::vec4 offset;
+};
+
+/**
+ *  @brief Builds one VkDrawIndexedIndirectCommand per visible chunk in the mesh arena and draws all of them with a
+ *  single vkCmdDrawIndexedIndirect. Every frame in flight has its own command and draw data buffer.
+ **/
+class ChunkDrawList {
+public:
+  void init(uint32_t frameCount, uint32_t capacity);
+  void destroy();
+
+  // Can recreate the frames buffers and update its descriptor set, call it before the set is bound
+  uint32_t build(uint32_t frame, const std::vector<Mesh> &meshes, const Frustum &frustum,
+                 const CaveCuller *caveCuller = nullptr);
+  void record(VkCommandBuffer cmdBuffer, uint32_t frame, uint32_t drawCount) const;
+
+  void reserve(uint32_t frame, uint32_t capacity);
+  [[nodiscard]] VkBuffer getCommandBuffer(uint32_t frame) const { return frames[frame].commandBuffer.buffer; }
+  [[nodiscard]] VkBuffer getDrawDataBuffer(uint32_t frame) const { return frames[frame].drawDataBuffer.buffer; }
+
+  void setIndirect(bool enabled) { indirect = enabled; }
+  [[nodiscard]] bool isIndirect() const { return indirect; }
+
+  [[nodiscard]] uint32_t getDrawnChunks() const { return drawnChunks; }
+  [[nodiscard]] uint32_t getFrustumCulledChunks() const { return frustumCulledChunks; }
+  [[nodiscard]] uint32_t getCaveCulledChunks() const { return caveCulledChunks; }
+
+private:
+  struct FrameBuffers {
+    Buffers::VmaBuffer commandBuffer{};
+    Buffers::VmaBuffer drawDataBuffer{};
+    void *commandsMapped{nullptr};
+    void *drawDataMapped{nullptr};
+    uint32_t capacity{0};
+  };
+
+  void createFrameBuffers(uint32_t frame, uint32_t capacity);
+  void destroyFrameBuffers(uint32_t frame);
+
+  std::vector<FrameBuffers> frames;
+
+  // CPU copies, the direct path reads these instead of the mapped gpu memory
+  std::vector<VkDrawIndexedIndirectCommand> commands;
+  std::vector<ChunkDrawData> drawData;
+
+  // Arena meshes of the scene and their bounds, index aligned
+  std::vector<const Mesh *> candidates;
+  AABBBatch candidateBounds;
+  std::vector<uint8_t> candidateVisible;
+
+  uint32_t drawnChunks{0};
+  uint32_t frustumCulledChunks{0};
+  uint32_t caveCulledChunks{0};
+
+  bool indirect{true};
+};
@@ -0,0 +1,31 @@
+#include "ChunkResources.h"
+
+#include "Engine.h"
+#include "Scene/SceneManager.h"
+
+#include <algorithm>
+
+size_t ChunkResources::getMeshVram(const Mesh &mesh) {
+  if (mesh.arenaHandle == MeshArena::INVALID_HANDLE) return 0;
+
+  const MeshAllocation &range = EngineData::i()->vkInstWrapper.chunkArena.get(mesh.arenaHandle);
+  return range.vertexCount * sizeof(BlockVertex) + range.indexCount * sizeof(uint32_t);
+}
+
+void ChunkResources::releaseMesh(const glm::ivec3 &pos, const Mesh &mesh) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  if (mesh.arenaHandle != MeshArena::INVALID_HANDLE) {
+    std::vector<Mesh> &meshes = SceneManager::i()->curScene.meshesInScene;
+    auto inScene = std::find_if(meshes.begin(), meshes.end(), [&](const Mesh &m) {
+      return m.arenaHandle == mesh.arenaHandle;
+    });
+    if (inScene != meshes.end()) meshes.erase(inScene);
+
+    vki.deletionQueue.push([mesh = mesh]() mutable {
+      mesh.destroy();
+    });
+  }
+
+  vki.caveCuller.removeChunk(pos);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+class Mesh;
+
+/**
+ *  @brief Renderer side of the chunks the ChunkEvictor unloads, it only sees the world.
+ **/
+namespace ChunkResources {
+  // Bytes the mesh takes in the chunk arena
+  size_t getMeshVram(const Mesh &mesh);
+
+  // Takes the mesh out of the scene and the cave culler, it is destroyed once no frame in flight uses it
+  void releaseMesh(const glm::ivec3 &pos, const Mesh &mesh);
+}
@@ -0,0 +1,28 @@
+#include "DeletionQueue.h"
+
+#include "Engine.h"
+
+void DeletionQueue::push(std::function<void()> &&deleter) {
+  pending.push_back({submittedFrames, std::move(deleter)});
+}
+
+/**
+ *  @brief Runs the deleters whose frames are all done. Only the other frames in flight can still be executing.
+ **/
+void DeletionQueue::collect() {
+  const uint64_t inFlight = MAX_FRAMES_IN_FLIGHT - 1;
+  if (submittedFrames < inFlight) return;
+  const uint64_t completedFrames = submittedFrames - inFlight;
+
+  while (!pending.empty() && pending.front().frame <= completedFrames) {
+    pending.front().deleter();
+    pending.pop_front();
+  }
+}
+
+void DeletionQueue::flush() {
+  for (Entry &entry: pending) {
+    entry.deleter();
+  }
+  pending.clear();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/**
+ *  @brief Defers freeing gpu resources until every frame that could still use them has finished.
+ **/
+class DeletionQueue {
+public:
+  void push(std::function<void()> &&deleter);
+
+  // After waiting on the fence of the frame that is recorded next
+  void collect();
+  void onFrameSubmitted() { submittedFrames++; }
+
+  // The device has to be idle
+  void flush();
+
+  [[nodiscard]] size_t size() const { return pending.size(); }
+
+private:
+  struct Entry {
+    // Frames submitted when the resource was released, all of them may still use it
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+
+  std::deque<Entry> pending;
+  uint64_t submittedFrames{0};
+};
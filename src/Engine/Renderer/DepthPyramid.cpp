@@ -0,0 +1,337 @@
+#include "DepthPyramid.h"
+
+#include "Engine.h"
+#include "Shader/Shader.h"
+#include "VulkanPipeline/Pipeline/Commandbuffer.h"
+#include "VulkanPipeline/Suitability/SuitabilityChecker.h"
+
+#include <algorithm>
+
+static constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+// Enough levels for a 65536 pixel wide depth buffer
+static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result * 2 <= value) result *= 2;
+  return result;
+}
+
+/**
+ *  @brief Creates the reduction pipeline and the pyramid for the current depth buffer. Stays unsupported if the
+ *  compiled shader is missing.
+ *  STAGE: After the depth buffering objects
+ **/
+void DepthPyramid::init() {
+  const std::string shaderPath = VOXLE_ROOT + std::string("/res/shader/compiled/depth_reduce.comp.spv");
+  if (!std::ifstream(shaderPath).good()) {
+    LOG(W, "Missing " + shaderPath + ", chunks won't be occlusion culled");
+    return;
+  }
+
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = static_cast<float>(MAX_PYRAMID_LEVELS);
+
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid sampler");
+
+  createPipeline();
+  createImage();
+
+  supported = true;
+}
+
+void DepthPyramid::destroy() {
+  if (!supported) return;
+
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+  destroyImage();
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorLayout, nullptr);
+  vkDestroySampler(device, sampler, nullptr);
+  supported = false;
+}
+
+/**
+ *  @brief The device has to be idle.
+ **/
+void DepthPyramid::resize() {
+  if (!supported) return;
+
+  destroyImage();
+  createImage();
+}
+
+/**
+ *  @brief Reduces the depth buffer into the pyramid, has to be recorded after the render pass.
+ **/
+void DepthPyramid::recordBuild(VkCommandBuffer cmdBuffer) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  VkImageMemoryBarrier depthBarrier{};
+  depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  depthBarrier.image = vki.depthImage.vkImage;
+  depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (SuitabilityChecker::hasDepthStencilComponent(SuitabilityChecker::getSupportedDepthFormat())) {
+    depthBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  depthBarrier.subresourceRange.levelCount = 1;
+  depthBarrier.subresourceRange.layerCount = 1;
+
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+  uint32_t srcWidth = vki.extent.width;
+  uint32_t srcHeight = vki.extent.height;
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    const uint32_t dstWidth = std::max(width >> level, 1u);
+    const uint32_t dstHeight = std::max(height >> level, 1u);
+
+    ReduceConstants constants{static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight),
+                              static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight)};
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &levelSets[level], 0,
+                            nullptr);
+    vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceConstants), &constants);
+    vkCmdDispatch(cmdBuffer, (dstWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                  (dstHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+    // The next level reads this one, the last barrier makes the pyramid visible to the next frames culling
+    VkMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &levelBarrier, 0, nullptr, 0, nullptr);
+
+    srcWidth = dstWidth;
+    srcHeight = dstHeight;
+  }
+
+  // Back to the layout the render pass expects, the next frame must not clear it before the reduction read it
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthBarrier.srcAccessMask = 0;
+  depthBarrier.dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+  built = true;
+}
+
+void DepthPyramid::createPipeline() {
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+  setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  setLayoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &descriptorLayout) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid descriptor set layout");
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = MAX_PYRAMID_LEVELS;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = MAX_PYRAMID_LEVELS;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = MAX_PYRAMID_LEVELS;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid descriptor pool");
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(ReduceConstants);
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &descriptorLayout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid pipeline layout");
+
+  const std::string shaderPath = VOXLE_ROOT + std::string("/res/shader/compiled/depth_reduce.comp.spv");
+  VkShaderModule shaderModule =
+      ShaderUtil::Module::createShaderModule(ShaderUtil::Loading::readShaderFile(shaderPath));
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+
+  if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid pipeline");
+
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+/**
+ *  @brief The first level is the largest power of two that fits into the depth buffer, so every level halves.
+ **/
+void DepthPyramid::createImage() {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  width = previousPowerOfTwo(vki.extent.width);
+  height = previousPowerOfTwo(vki.extent.height);
+  levelCount = 1;
+  while ((std::max(width, height) >> levelCount) > 0 && levelCount < MAX_PYRAMID_LEVELS) levelCount++;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.extent = {width, height, 1};
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  if (vmaCreateImage(vki.vmaAllocator, &imageInfo, &allocInfo, &image, &allocation, nullptr) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid image");
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(vki.device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+    LOG(F, "Failed to create the depth pyramid view");
+
+  levelViews.resize(levelCount);
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount = 1;
+    if (vkCreateImageView(vki.device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+      LOG(F, "Failed to create a depth pyramid level view");
+  }
+
+  // Written and sampled by compute only, so it never leaves the general layout
+  VkCommandBuffer cmdBuffer = Commandbuffer::recordSingleTime();
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                       nullptr, 0, nullptr, 1, &barrier);
+  Commandbuffer::endRecordSingleTime(cmdBuffer);
+
+  // One set per level, reading the level above or the depth buffer itself
+  std::vector<VkDescriptorSetLayout> layouts(levelCount, descriptorLayout);
+  levelSets.resize(levelCount);
+
+  VkDescriptorSetAllocateInfo setInfo{};
+  setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  setInfo.descriptorPool = descriptorPool;
+  setInfo.descriptorSetCount = levelCount;
+  setInfo.pSetLayouts = layouts.data();
+
+  if (vkAllocateDescriptorSets(vki.device, &setInfo, levelSets.data()) != VK_SUCCESS)
+    LOG(F, "Failed to allocate the depth pyramid descriptor sets");
+
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    VkDescriptorImageInfo srcInfo{};
+    srcInfo.sampler = sampler;
+    if (level == 0) {
+      srcInfo.imageView = vki.depthImage.vkImageView;
+      srcInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    } else {
+      srcInfo.imageView = levelViews[level - 1];
+      srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDescriptorImageInfo dstInfo{};
+    dstInfo.imageView = levelViews[level];
+    dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = levelSets[level];
+    writes[0].dstBinding = 0;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].descriptorCount = 1;
+    writes[0].pImageInfo = &srcInfo;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = levelSets[level];
+    writes[1].dstBinding = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].descriptorCount = 1;
+    writes[1].pImageInfo = &dstInfo;
+
+    vkUpdateDescriptorSets(vki.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  }
+
+  built = false;
+}
+
+void DepthPyramid::destroyImage() {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  vkResetDescriptorPool(vki.device, descriptorPool, 0);
+  levelSets.clear();
+
+  for (VkImageView levelView: levelViews) {
+    vkDestroyImageView(vki.device, levelView, nullptr);
+  }
+  levelViews.clear();
+  vkDestroyImageView(vki.device, view, nullptr);
+  vmaDestroyImage(vki.vmaAllocator, image, allocation);
+}
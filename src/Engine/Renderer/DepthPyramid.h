@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <vector>
+
+/**
+ *  @brief Mip chain of the depth buffer where every texel holds the farthest depth below it. Built after the scene
+ *  was drawn and read by the next frames chunk culling to reject chunks hidden behind terrain.
+ **/
+class DepthPyramid {
+public:
+  void init();
+  void destroy();
+
+  // The depth buffer was recreated with the swapchain
+  void resize();
+
+  void recordBuild(VkCommandBuffer cmdBuffer);
+  // Has to be rebuilt before it can be used for culling again
+  void invalidate() { built = false; }
+
+  [[nodiscard]] bool isSupported() const { return supported; }
+  [[nodiscard]] bool isBuilt() const { return built; }
+
+  [[nodiscard]] VkImageView getView() const { return view; }
+  [[nodiscard]] VkSampler getSampler() const { return sampler; }
+  [[nodiscard]] uint32_t getWidth() const { return width; }
+  [[nodiscard]] uint32_t getHeight() const { return height; }
+  [[nodiscard]] uint32_t getLevelCount() const { return levelCount; }
+
+private:
+  struct ReduceConstants {
+    int32_t srcWidth;
+    int32_t srcHeight;
+    int32_t dstWidth;
+    int32_t dstHeight;
+  };
+
+  void createPipeline();
+  void createImage();
+  void destroyImage();
+
+  VkImage image{};
+  VmaAllocation allocation{};
+  // Whole chain for sampling, one view per level for writing
+  VkImageView view{};
+  std::vector<VkImageView> levelViews;
+  std::vector<VkDescriptorSet> levelSets;
+
+  VkSampler sampler{};
+  VkDescriptorSetLayout descriptorLayout{};
+  VkDescriptorPool descriptorPool{};
+  VkPipelineLayout pipelineLayout{};
+  VkPipeline pipeline{};
+
+  uint32_t width{0};
+  uint32_t height{0};
+  uint32_t levelCount{0};
+
+  bool supported{false};
+  bool built{false};
+};
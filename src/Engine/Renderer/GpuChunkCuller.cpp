@@ -0,0 +1,382 @@
+#include "GpuChunkCuller.h"
+
+#include "Engine.h"
+#include "Shader/Shader.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+/**
+ *  @brief Creates the compute pipeline and the per frame buffers. Leaves the culler unsupported if the device lacks
+ *  drawIndirectCount or the compiled shader is missing.
+ *  STAGE: After the ChunkDrawList and the DepthPyramid
+ **/
+void GpuChunkCuller::init(uint32_t frameCount) {
+  const VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  if (!vki.drawIndirectCount || !vki.drawIndirectFirstInstance) {
+    LOG(W, "drawIndirectCount is not supported, chunks get culled on the cpu");
+    return;
+  }
+
+  const std::string shaderPath = VOXLE_ROOT + std::string("/res/shader/compiled/chunk_cull.comp.spv");
+  if (!std::ifstream(shaderPath).good()) {
+    LOG(W, "Missing " + shaderPath + ", chunks get culled on the cpu");
+    return;
+  }
+
+  // The culling shader samples the pyramid
+  if (!vki.depthPyramid.isSupported()) {
+    LOG(W, "No depth pyramid, chunks get culled on the cpu");
+    return;
+  }
+
+  createDescriptors(frameCount);
+  createPipeline();
+
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    FrameResources &resources = frames[frame];
+    Buffers::createBufferVMA(sizeof(CullCounts),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, resources.countBuffer.buffer,
+                             resources.countBuffer.allocation);
+    vmaMapMemory(vki.vmaAllocator, resources.countBuffer.allocation, &resources.countMapped);
+    Buffers::createBufferVMA(sizeof(CullParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, resources.paramsBuffer.buffer,
+                             resources.paramsBuffer.allocation);
+    vmaMapMemory(vki.vmaAllocator, resources.paramsBuffer.allocation, &resources.paramsMapped);
+    createCandidateBuffer(frame, 4096);
+  }
+
+  supported = true;
+  LOG(I, "Chunks get culled on the gpu");
+}
+
+void GpuChunkCuller::destroy() {
+  if (!supported) return;
+
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  for (uint32_t frame = 0; frame < frames.size(); ++frame) {
+    destroyCandidateBuffer(frame);
+    vmaUnmapMemory(vki.vmaAllocator, frames[frame].countBuffer.allocation);
+    vmaDestroyBuffer(vki.vmaAllocator, frames[frame].countBuffer.buffer, frames[frame].countBuffer.allocation);
+    vmaUnmapMemory(vki.vmaAllocator, frames[frame].paramsBuffer.allocation);
+    vmaDestroyBuffer(vki.vmaAllocator, frames[frame].paramsBuffer.buffer, frames[frame].paramsBuffer.allocation);
+  }
+  frames.clear();
+
+  vkDestroyPipeline(vki.device, pipeline, nullptr);
+  vkDestroyPipelineLayout(vki.device, pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(vki.device, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(vki.device, descriptorLayout, nullptr);
+  supported = false;
+}
+
+/**
+ *  @brief Makes an uploaded arena mesh visible to the culling shader.
+ **/
+void GpuChunkCuller::setChunk(uint32_t arenaHandle, const Mesh &mesh) {
+  if (!supported) return;
+
+  if (arenaHandle >= slots.size()) slots.resize(arenaHandle + 1, ChunkCandidate{});
+
+  const MeshAllocation &range = EngineData::i()->vkInstWrapper.chunkArena.get(arenaHandle);
+  const Point &center = mesh.bounds.getCenter();
+  const Point &halfWidth = mesh.bounds.getHalfWidth();
+
+  ChunkCandidate &slot = slots[arenaHandle];
+  if (slot.indexCount == 0 && range.indexCount > 0) chunkCount++;
+  slot.center = {center.x, center.y, center.z, 0};
+  slot.halfWidth = {halfWidth.x, halfWidth.y, halfWidth.z, 0};
+  slot.offset = mesh.meshRenderData.transformMatrix[3];
+  slot.indexCount = range.indexCount;
+  slot.firstIndex = range.firstIndex;
+  slot.vertexOffset = static_cast<int32_t>(range.firstVertex);
+  slotVersion++;
+}
+
+void GpuChunkCuller::removeChunk(uint32_t arenaHandle) {
+  if (!supported || arenaHandle >= slots.size()) return;
+  if (slots[arenaHandle].indexCount == 0) return;
+
+  slots[arenaHandle] = ChunkCandidate{};
+  chunkCount--;
+  slotVersion++;
+}
+
+/**
+ *  @brief Records the culling dispatch, has to happen outside of the render pass. The frame must not be in flight.
+ **/
+void GpuChunkCuller::recordCull(VkCommandBuffer cmdBuffer, uint32_t frame, const glm::mat4 &viewProj) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  FrameResources &resources = frames[frame];
+
+  // The last submission of this frame has finished, its counts are what it drew and occluded
+  vmaInvalidateAllocation(vki.vmaAllocator, resources.countBuffer.allocation, 0, VK_WHOLE_SIZE);
+  const CullCounts &counts = *static_cast<const CullCounts *>(resources.countMapped);
+  drawnChunks = counts.drawCount;
+  occludedChunks = counts.occludedCount;
+
+  if (arenaGeneration != vki.chunkArena.getGeneration()) refreshArenaRanges();
+
+  const auto slotCount = static_cast<uint32_t>(slots.size());
+  uploadSlots(frame);
+  vki.chunkDrawList.reserve(frame, std::max(slotCount, 1u));
+  updateDescriptors(frame);
+
+  const DepthPyramid &pyramid = vki.depthPyramid;
+  const Frustum frustum{viewProj};
+
+  CullParams params{};
+  const std::array<glm::vec4, 6> &planes = frustum.getPlanes();
+  std::copy(planes.begin(), planes.end(), params.planes);
+  params.pyramidViewProj = lastViewProj;
+  params.pyramidSize = {pyramid.getWidth(), pyramid.getHeight()};
+  params.pyramidLevels = pyramid.getLevelCount();
+  // Without last frames depth nothing can be occluded
+  params.occlusion = occlusion && pyramid.isBuilt();
+  params.candidateCount = slotCount;
+  memcpy(resources.paramsMapped, &params, sizeof(CullParams));
+  vmaFlushAllocation(vki.vmaAllocator, resources.paramsBuffer.allocation, 0, VK_WHOLE_SIZE);
+  lastViewProj = viewProj;
+
+  vkCmdFillBuffer(cmdBuffer, resources.countBuffer.buffer, 0, sizeof(CullCounts), 0);
+
+  VkMemoryBarrier clearBarrier{};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &clearBarrier, 0, nullptr, 0, nullptr);
+
+  if (slotCount > 0) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+                            &resources.descriptorSet, 0, nullptr);
+    vkCmdDispatch(cmdBuffer, (slotCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+  }
+
+  // Draws read the commands and count as indirect arguments and the offsets in the vertex shader.
+  // The host reads the count for the stats once the frame is done
+  VkMemoryBarrier cullBarrier{};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+/**
+ *  @brief Records the draws written by recordCull. The arena buffers, pipeline and descriptor set have to be bound.
+ **/
+void GpuChunkCuller::recordDraw(VkCommandBuffer cmdBuffer, uint32_t frame) const {
+  const auto maxDraws = static_cast<uint32_t>(slots.size());
+  if (maxDraws == 0) return;
+
+  const ChunkDrawList &drawList = EngineData::i()->vkInstWrapper.chunkDrawList;
+  vkCmdDrawIndexedIndirectCount(cmdBuffer, drawList.getCommandBuffer(frame), 0, frames[frame].countBuffer.buffer, 0,
+                                maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuChunkCuller::createPipeline() {
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  const std::string shaderPath = VOXLE_ROOT + std::string("/res/shader/compiled/chunk_cull.comp.spv");
+  VkShaderModule shaderModule =
+      ShaderUtil::Module::createShaderModule(ShaderUtil::Loading::readShaderFile(shaderPath));
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &descriptorLayout;
+
+  if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    LOG(F, "Failed to create the chunk culling pipeline layout");
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+
+  if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    LOG(F, "Failed to create the chunk culling pipeline");
+
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+/**
+ *  @brief Candidates, commands, draw data, the counts, the cull parameters and the depth pyramid, one set per frame.
+ **/
+void GpuChunkCuller::createDescriptors(uint32_t frameCount) {
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+  for (uint32_t i = 0; i < bindings.size(); ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorLayout) != VK_SUCCESS)
+    LOG(F, "Failed to create the chunk culling descriptor set layout");
+
+  std::array<VkDescriptorPoolSize, 3> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[0].descriptorCount = 4 * frameCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  poolSizes[1].descriptorCount = frameCount;
+  poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[2].descriptorCount = frameCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = frameCount;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    LOG(F, "Failed to create the chunk culling descriptor pool");
+
+  std::vector<VkDescriptorSetLayout> layouts(frameCount, descriptorLayout);
+  std::vector<VkDescriptorSet> sets(frameCount);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = frameCount;
+  allocInfo.pSetLayouts = layouts.data();
+
+  if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+    LOG(F, "Failed to allocate the chunk culling descriptor sets");
+
+  frames.resize(frameCount);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    frames[frame].descriptorSet = sets[frame];
+  }
+}
+
+void GpuChunkCuller::createCandidateBuffer(uint32_t frame, uint32_t capacity) {
+  VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
+  FrameResources &resources = frames[frame];
+
+  Buffers::createBufferVMA(sizeof(ChunkCandidate) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, resources.candidateBuffer.buffer,
+                           resources.candidateBuffer.allocation);
+  vmaMapMemory(allocator, resources.candidateBuffer.allocation, &resources.candidatesMapped);
+  resources.capacity = capacity;
+  // Forces a full upload into the new buffer
+  resources.version = 0;
+}
+
+void GpuChunkCuller::destroyCandidateBuffer(uint32_t frame) {
+  VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
+  FrameResources &resources = frames[frame];
+  if (resources.capacity == 0) return;
+
+  vmaUnmapMemory(allocator, resources.candidateBuffer.allocation);
+  vmaDestroyBuffer(allocator, resources.candidateBuffer.buffer, resources.candidateBuffer.allocation);
+  resources.candidateBuffer = Buffers::VmaBuffer{};
+  resources.candidatesMapped = nullptr;
+  resources.capacity = 0;
+}
+
+/**
+ *  @brief The arena moved its meshes while compacting or growing, every slot needs its new ranges.
+ **/
+void GpuChunkCuller::refreshArenaRanges() {
+  const MeshArena &arena = EngineData::i()->vkInstWrapper.chunkArena;
+  for (uint32_t handle = 0; handle < slots.size(); ++handle) {
+    ChunkCandidate &slot = slots[handle];
+    if (slot.indexCount == 0) continue;
+
+    const MeshAllocation &range = arena.get(handle);
+    slot.firstIndex = range.firstIndex;
+    slot.vertexOffset = static_cast<int32_t>(range.firstVertex);
+  }
+  arenaGeneration = arena.getGeneration();
+  slotVersion++;
+}
+
+/**
+ *  @brief Copies the slots into the candidate buffer of the frame if they changed since it was last written.
+ **/
+void GpuChunkCuller::uploadSlots(uint32_t frame) {
+  FrameResources &resources = frames[frame];
+  if (resources.version == slotVersion) return;
+
+  const auto slotCount = static_cast<uint32_t>(slots.size());
+  if (slotCount > resources.capacity) {
+    uint32_t capacity = std::max(resources.capacity, 1u);
+    while (capacity < slotCount) capacity *= 2;
+    destroyCandidateBuffer(frame);
+    createCandidateBuffer(frame, capacity);
+  }
+
+  if (slotCount > 0) {
+    memcpy(resources.candidatesMapped, slots.data(), sizeof(ChunkCandidate) * slotCount);
+    vmaFlushAllocation(EngineData::i()->vkInstWrapper.vmaAllocator, resources.candidateBuffer.allocation, 0,
+                       VK_WHOLE_SIZE);
+  }
+  resources.version = slotVersion;
+}
+
+/**
+ *  @brief The ChunkDrawList and the depth pyramid may have recreated their resources, so the set is rewritten every
+ *  frame.
+ **/
+void GpuChunkCuller::updateDescriptors(uint32_t frame) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  FrameResources &resources = frames[frame];
+
+  const std::array<VkBuffer, 5> buffers = {resources.candidateBuffer.buffer,
+                                           vki.chunkDrawList.getCommandBuffer(frame),
+                                           vki.chunkDrawList.getDrawDataBuffer(frame),
+                                           resources.countBuffer.buffer,
+                                           resources.paramsBuffer.buffer};
+
+  std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+  std::array<VkWriteDescriptorSet, 6> writes{};
+  for (uint32_t i = 0; i < buffers.size(); ++i) {
+    bufferInfos[i].buffer = buffers[i];
+    bufferInfos[i].offset = 0;
+    bufferInfos[i].range = VK_WHOLE_SIZE;
+
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = resources.descriptorSet;
+    writes[i].dstBinding = i;
+    writes[i].dstArrayElement = 0;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].descriptorCount = 1;
+    writes[i].pBufferInfo = &bufferInfos[i];
+  }
+  writes[4].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+  VkDescriptorImageInfo pyramidInfo{};
+  pyramidInfo.sampler = vki.depthPyramid.getSampler();
+  pyramidInfo.imageView = vki.depthPyramid.getView();
+  pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  writes[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[5].dstSet = resources.descriptorSet;
+  writes[5].dstBinding = 5;
+  writes[5].dstArrayElement = 0;
+  writes[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[5].descriptorCount = 1;
+  writes[5].pImageInfo = &pyramidInfo;
+
+  vkUpdateDescriptorSets(vki.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "VulkanPipeline/Pipeline/Buffer/Buffer.h"
+#include "Collision/Frustum.hpp"
+
+#include <vector>
+
+class Mesh;
+
+/**
+ *  @brief One chunk slot as read by chunk_cull.comp, indexed by the arena handle of the chunk mesh.
+ **/
+struct ChunkCandidate {
+  glm::vec4 center;
+  glm::vec4 halfWidth;
+  glm::vec4 offset;
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t pad;
+};
+
+/**
+ *  @brief Frustum culls the chunks of the mesh arena in a compute shader which writes the visible draws and their
+ *  count into the buffers of the ChunkDrawList, drawn with vkCmdDrawIndexedIndirectCount. Chunks hidden behind the
+ *  last frames depth pyramid are rejected as well. Needs drawIndirectCount, otherwise the ChunkDrawList culls on the
+ *  cpu.
+ **/
+class GpuChunkCuller {
+public:
+  void init(uint32_t frameCount);
+  void destroy();
+
+  void setChunk(uint32_t arenaHandle, const Mesh &mesh);
+  void removeChunk(uint32_t arenaHandle);
+
+  void recordCull(VkCommandBuffer cmdBuffer, uint32_t frame, const glm::mat4 &viewProj);
+  void recordDraw(VkCommandBuffer cmdBuffer, uint32_t frame) const;
+
+  [[nodiscard]] bool isSupported() const { return supported; }
+  [[nodiscard]] bool isActive() const { return supported && enabled; }
+  void setEnabled(bool enable) { enabled = enable; }
+
+  [[nodiscard]] bool isOcclusionEnabled() const { return occlusion; }
+  void setOcclusionEnabled(bool enable) { occlusion = enable; }
+
+  // Read back from the last completed frame, one frame behind
+  [[nodiscard]] uint32_t getDrawnChunks() const { return drawnChunks; }
+  [[nodiscard]] uint32_t getOccludedChunks() const { return occludedChunks; }
+  [[nodiscard]] uint32_t getChunkCount() const { return chunkCount; }
+
+private:
+  struct FrameResources {
+    Buffers::VmaBuffer candidateBuffer{};
+    Buffers::VmaBuffer countBuffer{};
+    Buffers::VmaBuffer paramsBuffer{};
+    void *candidatesMapped{nullptr};
+    void *countMapped{nullptr};
+    void *paramsMapped{nullptr};
+    uint32_t capacity{0};
+    // Slot version this frames candidate buffer was written with
+    uint64_t version{0};
+    VkDescriptorSet descriptorSet{};
+  };
+
+  // std140 layout of CullParams in chunk_cull.comp
+  struct CullParams {
+    glm::vec4 planes[6];
+    glm::mat4 pyramidViewProj;
+    glm::vec2 pyramidSize;
+    uint32_t pyramidLevels;
+    uint32_t occlusion;
+    uint32_t candidateCount;
+  };
+
+  // Matches DrawCount in chunk_cull.comp
+  struct CullCounts {
+    uint32_t drawCount;
+    uint32_t occludedCount;
+  };
+
+  void createPipeline();
+  void createDescriptors(uint32_t frameCount);
+  void createCandidateBuffer(uint32_t frame, uint32_t capacity);
+  void destroyCandidateBuffer(uint32_t frame);
+  void refreshArenaRanges();
+  void uploadSlots(uint32_t frame);
+  void updateDescriptors(uint32_t frame);
+
+  std::vector<FrameResources> frames;
+
+  // Master copy of every slot, unused slots have an indexCount of 0
+  std::vector<ChunkCandidate> slots;
+  uint64_t slotVersion{1};
+  uint64_t arenaGeneration{0};
+
+  // The depth pyramid holds the depth rendered with this matrix
+  glm::mat4 lastViewProj{1.0f};
+
+  VkDescriptorSetLayout descriptorLayout{};
+  VkDescriptorPool descriptorPool{};
+  VkPipelineLayout pipelineLayout{};
+  VkPipeline pipeline{};
+
+  uint32_t drawnChunks{0};
+  uint32_t occludedChunks{0};
+  uint32_t chunkCount{0};
+
+  bool supported{false};
+  bool enabled{true};
+  bool occlusion{true};
+};
@@ -0,0 +1,126 @@
+#include "GpuProfiler.h"
+
+#include "Engine.h"
+#include "Logging/Profiler.hpp"
+#include "VulkanPipeline/Queue/QueueHelper.h"
+
+static constexpr uint32_t NO_ZONE = UINT32_MAX;
+
+GpuProfiler::Zone::Zone(GpuProfiler &profiler, VkCommandBuffer cmdBuffer, const char *name)
+    : profiler(profiler), cmdBuffer(cmdBuffer), zone(profiler.beginZone(cmdBuffer, name)) {}
+
+GpuProfiler::Zone::~Zone() {
+  profiler.endZone(cmdBuffer, zone);
+}
+
+/**
+ *  @brief Creates the query pool. Stays unsupported if the graphics queue can't write timestamps.
+ *  STAGE: After the logical device
+ **/
+void GpuProfiler::init(uint32_t frameCount) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(vki.physicalDevice, &properties);
+
+  const QueueFamilyIndices indices = QueueHelper::findQueueFamilies(vki.physicalDevice, vki.surface);
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(vki.physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(vki.physicalDevice, &familyCount, families.data());
+
+  const uint32_t validBits = indices.graphicsFamily.has_value() && indices.graphicsFamily.value() < familyCount
+                             ? families[indices.graphicsFamily.value()].timestampValidBits : 0;
+  if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+    LOG(W, "The graphics queue has no timestamps, gpu zones won't be profiled");
+    return;
+  }
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = frameCount * MAX_ZONES * 2;
+  if (vkCreateQueryPool(vki.device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+    LOG(E, "Failed to create the timestamp query pool");
+    return;
+  }
+
+  timestampPeriod = properties.limits.timestampPeriod;
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+  frames.assign(frameCount, FrameZones{});
+  supported = true;
+}
+
+void GpuProfiler::destroy() {
+  if (!supported) return;
+  vkDestroyQueryPool(EngineData::i()->vkInstWrapper.device, queryPool, nullptr);
+  frames.clear();
+  supported = false;
+}
+
+/**
+ *  @brief Has to be called right after the command buffer of frame was begun, its fence must have signaled.
+ **/
+void GpuProfiler::beginFrame(VkCommandBuffer cmdBuffer, uint32_t frame) {
+  if (!supported) return;
+
+  readResults(frame);
+
+  currentFrame = frame;
+  frames[frame].zoneCount = 0;
+  frames[frame].cpuStart = Profiler::now();
+  vkCmdResetQueryPool(cmdBuffer, queryPool, frame * MAX_ZONES * 2, MAX_ZONES * 2);
+}
+
+/**
+ *  @brief Writes the start timestamp of a zone, returns the zone for endZone.
+ **/
+uint32_t GpuProfiler::beginZone(VkCommandBuffer cmdBuffer, const char *name) {
+  if (!supported) return NO_ZONE;
+
+  FrameZones &zones = frames[currentFrame];
+  if (zones.zoneCount == MAX_ZONES) {
+    LOG_FIRST(W, 1, "More than " << MAX_ZONES << " gpu zones in a frame, the rest isn't profiled");
+    return NO_ZONE;
+  }
+
+  const uint32_t zone = zones.zoneCount++;
+  zones.names[zone] = name;
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, (currentFrame * MAX_ZONES + zone) * 2);
+  return zone;
+}
+
+void GpuProfiler::endZone(VkCommandBuffer cmdBuffer, uint32_t zone) {
+  if (!supported || zone == NO_ZONE) return;
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool,
+                      (currentFrame * MAX_ZONES + zone) * 2 + 1);
+}
+
+/**
+ *  @brief Converts the timestamps of the last use of frame into zone times and hands them to the Profiler.
+ **/
+void GpuProfiler::readResults(uint32_t frame) {
+  const FrameZones &zones = frames[frame];
+  if (zones.zoneCount == 0) return;
+
+  uint64_t timestamps[MAX_ZONES * 2];
+  const VkResult result = vkGetQueryPoolResults(EngineData::i()->vkInstWrapper.device, queryPool,
+                                                frame * MAX_ZONES * 2, zones.zoneCount * 2, sizeof(timestamps),
+                                                timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  // Not ready can only happen if the frame was never submitted
+  if (result != VK_SUCCESS) return;
+
+  const uint64_t frameStart = timestamps[0] & timestampMask;
+  zoneTimes.clear();
+  for (uint32_t zone = 0; zone < zones.zoneCount; ++zone) {
+    const uint64_t begin = timestamps[zone * 2] & timestampMask;
+    const uint64_t end = timestamps[zone * 2 + 1] & timestampMask;
+    // Wrapped around or the zone was never ended
+    if (end < begin || begin < frameStart) continue;
+
+    const auto startNs = static_cast<uint64_t>(static_cast<double>(begin - frameStart) * timestampPeriod);
+    const auto durationNs = static_cast<uint64_t>(static_cast<double>(end - begin) * timestampPeriod);
+    Profiler::recordGpuZone(zones.names[zone], zones.cpuStart + startNs, zones.cpuStart + startNs + durationNs);
+    zoneTimes.push_back({zones.names[zone], static_cast<float>(durationNs) / 1000000.0f});
+  }
+}
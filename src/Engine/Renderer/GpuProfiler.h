@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ *  @brief Times sections of the frames command buffer with timestamp queries.
+ *  Every frame in flight has its own range of queries. They are read back once the frames fence signaled, when the
+ *  frame slot gets recorded again, so results are a few frames late. The zones are handed to the Profiler for the
+ *  trace, placed relative to the cpu time the frame was recorded at since the gpu clock isn't calibrated against it.
+ **/
+class GpuProfiler {
+public:
+  static constexpr uint32_t MAX_ZONES = 16;
+
+  struct ZoneTime {
+    const char *name;
+    float ms;
+  };
+
+  /**
+   *  @brief Times the commands recorded during its lifetime, does nothing if timestamps are unsupported.
+   **/
+  class Zone {
+  public:
+    Zone(GpuProfiler &profiler, VkCommandBuffer cmdBuffer, const char *name);
+    ~Zone();
+
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+  private:
+    GpuProfiler &profiler;
+    VkCommandBuffer cmdBuffer;
+    uint32_t zone;
+  };
+
+  void init(uint32_t frameCount);
+  void destroy();
+
+  // Reads back the results of the last use of frame and resets its queries, outside of a render pass
+  void beginFrame(VkCommandBuffer cmdBuffer, uint32_t frame);
+
+  uint32_t beginZone(VkCommandBuffer cmdBuffer, const char *name);
+  void endZone(VkCommandBuffer cmdBuffer, uint32_t zone);
+
+  [[nodiscard]] bool isSupported() const { return supported; }
+  // Zones of the newest frame that was read back
+  [[nodiscard]] const std::vector<ZoneTime> &getZoneTimes() const { return zoneTimes; }
+
+private:
+  struct FrameZones {
+    const char *names[MAX_ZONES]{};
+    uint32_t zoneCount{0};
+    // Cpu time the frame was recorded at
+    uint64_t cpuStart{0};
+  };
+
+  void readResults(uint32_t frame);
+
+  VkQueryPool queryPool{};
+  std::vector<FrameZones> frames;
+  uint32_t currentFrame{0};
+
+  // Nanoseconds per timestamp tick
+  float timestampPeriod{1.0f};
+  uint64_t timestampMask{~0ull};
+
+  std::vector<ZoneTime> zoneTimes;
+  bool supported{false};
+};
@@ -3,6 +3,12 @@
 #include "Engine.h"
 
 void Mesh::destroy() {
+  if (arenaHandle != MeshArena::INVALID_HANDLE) {
+    EngineData::i()->vkInstWrapper.gpuChunkCuller.removeChunk(arenaHandle);
+    EngineData::i()->vkInstWrapper.chunkArena.free(arenaHandle);
+    arenaHandle = MeshArena::INVALID_HANDLE;
+  }
+
   VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
   vmaDestroyBuffer(allocator, vertexBuffer.buffer, vertexBuffer.allocation);
   vmaDestroyBuffer(allocator, indexBuffer.indexBuffer, indexBuffer.allocation);
@@ -2,13 +2,22 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanPipeline/Pipeline/Buffer/Buffer.h"
+#include "VulkanPipeline/Pipeline/Buffer/MeshArena.h"
 #include "VulkanPipeline/Pipeline/PushConstants/GenericPushConstants.h"
-#include "GraphicsPipeline.h"
+#include "Collision/AABB.hpp"
+
+namespace VulkanPipeline {
+  class Pipeline;
+}
 
 class Mesh {
 public:
   Buffers::VmaBuffer vertexBuffer{};
   Buffers::IndexBuffer indexBuffer{};
+  // Set if the mesh lives in the chunk arena instead of its own buffers
+  uint32_t arenaHandle{MeshArena::INVALID_HANDLE};
+  // World space bounds for culling
+  AABB bounds{Point{0, 0, 0}, Point{0, 0, 0}};
   MeshPushConstant meshRenderData{};
 
   size_t vertexCount{0};
@@ -1,6 +1,8 @@
 #include "PrimitiveRenderer.h"
+#include "Logging/Profiler.hpp"
 
 void PrimitiveRenderer::render(Camera& cam) {
+  PROFILE_ZONE("render");
   int& currentFrame = EngineData::i()->vkInstWrapper.currentFrame;
 
   VkDevice &device = EngineData::i()->vkInstWrapper.device;
@@ -14,7 +16,11 @@ void PrimitiveRenderer::render(Camera& cam) {
   VkSemaphore& imageSema = EngineData::i()->vkInstWrapper.imageAvailableSemas[currentFrame];
   VkSemaphore& renderSema = EngineData::i()->vkInstWrapper.renderFinishedSemas[currentFrame];
 
-  vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+  {
+    PROFILE_ZONE("waitForFrameFence");
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  EngineData::i()->vkInstWrapper.deletionQueue.collect();
 
   uint32_t imageIndex;
 
@@ -55,6 +61,7 @@ void PrimitiveRenderer::render(Camera& cam) {
 
   if(vkQueueSubmit(EngineData::i()->vkInstWrapper.graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS)
     LOG(F, "Could not submit command buffer, stopping renderer");
+  EngineData::i()->vkInstWrapper.deletionQueue.onFrameSubmitted();
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -68,7 +75,10 @@ void PrimitiveRenderer::render(Camera& cam) {
   presentInfo.pResults = nullptr;
 
   // Present the next image to the window
-  scRes = vkQueuePresentKHR(EngineData::i()->vkInstWrapper.presentQueue, &presentInfo);
+  {
+    PROFILE_ZONE("present");
+    scRes = vkQueuePresentKHR(EngineData::i()->vkInstWrapper.presentQueue, &presentInfo);
+  }
   if(scRes == VK_ERROR_OUT_OF_DATE_KHR || scRes == VK_SUBOPTIMAL_KHR || EngineData::i()->vkInstWrapper.framebufferWasResized) {
     EngineData::i()->vkInstWrapper.framebufferWasResized = false;
     VkSetup::recreateSwapchain(device);
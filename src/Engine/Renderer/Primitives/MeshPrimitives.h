@@ -45,6 +45,7 @@ struct Vertex {
 
 struct BlockVertex {
   unsigned int packedVert;
+  unsigned int packedQuad; // Quad width | height << 6, used for tiling textures over merged faces
 
   static VkVertexInputBindingDescription getBindingDescription() {
     VkVertexInputBindingDescription bindingDescription{};
@@ -55,13 +56,19 @@ struct BlockVertex {
   }
 
   static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
-    std::vector<VkVertexInputAttributeDescription> attrDesc{1};
+    std::vector<VkVertexInputAttributeDescription> attrDesc{2};
 
     // Packed values Vertex Pos, Index, TexID (wip)
     attrDesc[0].binding = 0;
     attrDesc[0].location = 0;
     attrDesc[0].format = VK_FORMAT_R32_UINT;
     attrDesc[0].offset = offsetof(BlockVertex, packedVert);
+
+    // Packed quad size for greedy meshed faces
+    attrDesc[1].binding = 0;
+    attrDesc[1].location = 1;
+    attrDesc[1].format = VK_FORMAT_R32_UINT;
+    attrDesc[1].offset = offsetof(BlockVertex, packedQuad);
     return attrDesc;
   }
 };
\ No newline at end of file
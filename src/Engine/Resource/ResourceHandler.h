@@ -5,11 +5,10 @@
 #include <string>
 #include <vector>
 
+// Block textures are loaded by the TextureManager
 class Resources {
-  // TODO: Texture Handling
 public:
   static void createTexture(VulkanImage::Image &t, const std::string& path);
-  static void createTextureArray(std::vector<VulkanImage::Image> images);
 private:
   inline static const std::string TEXTURE_PATH = VOXLE_ROOT + std::string("/res/texture/");
 };
\ No newline at end of file
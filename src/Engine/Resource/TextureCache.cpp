@@ -0,0 +1,440 @@
+#include "TextureCache.h"
+
+#include "Logging/Logger.h"
+#include "Logging/Profiler.hpp"
+#include "Threading/JobSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char CACHE_MAGIC[4] = {'V', 'X', 'T', 'C'};
+// Bumped whenever the layout or the encoder changes
+static constexpr uint32_t CACHE_VERSION = 1;
+static constexpr uint32_t FORMAT_BC1 = 1;
+
+// Magic, version, format, size, layer count, level count, source count and the data offset
+static constexpr size_t HEADER_BYTES = 32;
+static constexpr size_t DATA_ALIGNMENT = 16;
+
+/**
+ *  @brief Bounds checked cursor over the cache, any read past the end clears ok and returns 0.
+ **/
+struct CacheReader {
+  const uint8_t *pos;
+  const uint8_t *end;
+  bool ok = true;
+
+  template<typename T>
+  T read() {
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(T))) {
+      ok = false;
+      return 0;
+    }
+    T value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+  }
+};
+
+template<typename T>
+static void put(std::vector<uint8_t> &out, T value) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static uint32_t blocksAcross(uint32_t levelSize) {
+  return std::max((levelSize + 3) / 4, 1u);
+}
+
+/**
+ *  @brief Box filters src (size x size) into dst, odd texels at the edge are clamped.
+ **/
+static void downsample(const uint8_t *src, uint32_t size, uint8_t *dst) {
+  const uint32_t next = std::max(size / 2, 1u);
+  for (uint32_t y = 0; y < next; ++y) {
+    const uint32_t y0 = std::min(y * 2, size - 1), y1 = std::min(y * 2 + 1, size - 1);
+    for (uint32_t x = 0; x < next; ++x) {
+      const uint32_t x0 = std::min(x * 2, size - 1), x1 = std::min(x * 2 + 1, size - 1);
+      for (uint32_t c = 0; c < 4; ++c) {
+        const uint32_t sum = src[(y0 * size + x0) * 4 + c] + src[(y0 * size + x1) * 4 + c] +
+                             src[(y1 * size + x0) * 4 + c] + src[(y1 * size + x1) * 4 + c];
+        dst[(y * next + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+static uint16_t toRgb565(const float color[3]) {
+  const auto r = static_cast<uint16_t>(std::clamp(std::lround(color[0] * 31.0f / 255.0f), 0l, 31l));
+  const auto g = static_cast<uint16_t>(std::clamp(std::lround(color[1] * 63.0f / 255.0f), 0l, 63l));
+  const auto b = static_cast<uint16_t>(std::clamp(std::lround(color[2] * 31.0f / 255.0f), 0l, 31l));
+  return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+static void fromRgb565(uint16_t value, int color[3]) {
+  const int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+  color[0] = r << 3 | r >> 2;
+  color[1] = g << 2 | g >> 4;
+  color[2] = b << 3 | b >> 2;
+}
+
+/**
+ *  @brief Encodes 4x4 RGBA texels into a BC1 block.
+ *  The endpoints are the extreme texels along the principal axis of the opaque colors. Blocks with texels below half
+ *  alpha use the three color mode, the fourth index is transparent which keeps cutout textures like leaves intact.
+ **/
+static void encodeBlock(const uint8_t texels[16][4], uint8_t *out) {
+  bool transparent[16];
+  float mean[3]{};
+  int opaqueCount = 0;
+  for (int i = 0; i < 16; ++i) {
+    transparent[i] = texels[i][3] < 128;
+    if (transparent[i]) continue;
+    for (int c = 0; c < 3; ++c) mean[c] += texels[i][c];
+    opaqueCount++;
+  }
+
+  uint16_t color0 = 0, color1 = 0;
+  uint32_t indices = 0;
+  if (opaqueCount == 0) {
+    // color0 <= color1 selects the three color mode, index 3 is transparent
+    indices = 0xFFFFFFFFu;
+  } else {
+    for (float &c: mean) c /= static_cast<float>(opaqueCount);
+
+    float covariance[6]{};
+    for (int i = 0; i < 16; ++i) {
+      if (transparent[i]) continue;
+      const float r = texels[i][0] - mean[0], g = texels[i][1] - mean[1], b = texels[i][2] - mean[2];
+      covariance[0] += r * r;
+      covariance[1] += r * g;
+      covariance[2] += r * b;
+      covariance[3] += g * g;
+      covariance[4] += g * b;
+      covariance[5] += b * b;
+    }
+
+    // A few power iterations are plenty for 16 texels
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 4; ++iteration) {
+      const float next[3] = {
+        covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+        covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+        covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+      };
+      const float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+      if (length == 0.0f) break;
+      for (int c = 0; c < 3; ++c) axis[c] = next[c] / length;
+    }
+
+    int minTexel = -1, maxTexel = -1;
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+      if (transparent[i]) continue;
+      const float projection = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+      if (minTexel < 0 || projection < minProjection) minTexel = i, minProjection = projection;
+      if (maxTexel < 0 || projection > maxProjection) maxTexel = i, maxProjection = projection;
+    }
+
+    const float maxColor[3] = {float(texels[maxTexel][0]), float(texels[maxTexel][1]), float(texels[maxTexel][2])};
+    const float minColor[3] = {float(texels[minTexel][0]), float(texels[minTexel][1]), float(texels[minTexel][2])};
+    color0 = toRgb565(maxColor);
+    color1 = toRgb565(minColor);
+
+    const bool threeColor = opaqueCount < 16;
+    // The order of the endpoints selects the mode
+    if (threeColor ? color0 > color1 : color0 < color1) std::swap(color0, color1);
+
+    int palette[4][3];
+    fromRgb565(color0, palette[0]);
+    fromRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      if (threeColor) {
+        palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      } else {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+      }
+    }
+
+    // Equal endpoints in the four color mode would switch to three colors, index 0 is exact then anyway
+    const int paletteSize = color0 == color1 ? 1 : threeColor ? 3 : 4;
+    for (int i = 0; i < 16; ++i) {
+      uint32_t best = 3;
+      if (!transparent[i]) {
+        int bestDistance = INT32_MAX;
+        for (int p = 0; p < paletteSize; ++p) {
+          int distance = 0;
+          for (int c = 0; c < 3; ++c) {
+            const int difference = texels[i][c] - palette[p][c];
+            distance += difference * difference;
+          }
+          if (distance < bestDistance) bestDistance = distance, best = static_cast<uint32_t>(p);
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  std::memcpy(out, &color0, 2);
+  std::memcpy(out + 2, &color1, 2);
+  std::memcpy(out + 4, &indices, 4);
+}
+
+/**
+ *  @brief Encodes a level of one layer, levels smaller than a block repeat their edge texels.
+ **/
+static void encodeLevel(const uint8_t *texels, uint32_t levelSize, uint8_t *out) {
+  const uint32_t blocks = blocksAcross(levelSize);
+  uint8_t block[16][4];
+  for (uint32_t by = 0; by < blocks; ++by) {
+    for (uint32_t bx = 0; bx < blocks; ++bx) {
+      for (uint32_t i = 0; i < 16; ++i) {
+        const uint32_t x = std::min(bx * 4 + i % 4, levelSize - 1);
+        const uint32_t y = std::min(by * 4 + i / 4, levelSize - 1);
+        std::memcpy(block[i], texels + (y * levelSize + x) * 4, 4);
+      }
+      encodeBlock(block, out + (by * blocks + bx) * TextureCache::BLOCK_BYTES);
+    }
+  }
+}
+
+TextureCache::~TextureCache() {
+  close();
+}
+
+bool TextureCache::open(const std::string &path, const std::vector<SourceFile> &expectedSources) {
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize{};
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) return false;
+
+  // The view keeps the mapping alive
+  void *mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (mapped == nullptr) return false;
+
+  viewSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info{};
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  viewSize = static_cast<size_t>(info.st_size);
+#endif
+  view = static_cast<const uint8_t *>(mapped);
+
+  if (!parse(view, viewSize)) {
+    LOG(W, "Ignoring texture cache " << path << ", it is damaged or of another version");
+    close();
+    return false;
+  }
+  if (sources != expectedSources) {
+    LOG(I, "Texture cache " << path << " is stale, the textures changed");
+    close();
+    return false;
+  }
+  return true;
+}
+
+void TextureCache::close() {
+  unmap();
+  baked.clear();
+  baked.shrink_to_fit();
+  levels.clear();
+  sources.clear();
+  data = nullptr;
+  dataSize = 0;
+  size = 0;
+  layerCount = 0;
+}
+
+void TextureCache::unmap() {
+  if (view == nullptr || !baked.empty()) {
+    view = nullptr;
+    viewSize = 0;
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(view);
+#else
+  munmap(const_cast<uint8_t *>(view), viewSize);
+#endif
+  view = nullptr;
+  viewSize = 0;
+}
+
+/**
+ *  @brief Reads the header, level and source tables and checks that every level lies inside the file.
+ **/
+bool TextureCache::parse(const uint8_t *file, size_t fileSize) {
+  CacheReader reader{file, file + fileSize};
+  if (fileSize < HEADER_BYTES || std::memcmp(file, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) return false;
+  reader.pos += sizeof(CACHE_MAGIC);
+
+  const auto version = reader.read<uint32_t>();
+  const auto format = reader.read<uint32_t>();
+  size = reader.read<uint32_t>();
+  layerCount = reader.read<uint32_t>();
+  const auto levelCount = reader.read<uint32_t>();
+  const auto sourceCount = reader.read<uint32_t>();
+  const auto dataOffset = reader.read<uint32_t>();
+  if (version != CACHE_VERSION || format != FORMAT_BC1 || size == 0 || layerCount == 0 || levelCount == 0 ||
+      levelCount > 32 || dataOffset > fileSize) {
+    return false;
+  }
+
+  dataSize = fileSize - dataOffset;
+  levels.resize(levelCount);
+  uint32_t levelSize = size;
+  for (Level &level: levels) {
+    level.size = levelSize;
+    level.offset = reader.read<uint64_t>();
+    level.bytes = reader.read<uint64_t>();
+    const uint64_t expected = static_cast<uint64_t>(blocksAcross(levelSize)) * blocksAcross(levelSize) * BLOCK_BYTES *
+                              layerCount;
+    if (level.bytes != expected || level.offset > dataSize || level.bytes > dataSize - level.offset) return false;
+    levelSize = std::max(levelSize / 2, 1u);
+  }
+
+  sources.resize(sourceCount);
+  for (SourceFile &source: sources) {
+    source.size = reader.read<uint64_t>();
+    source.modified = reader.read<int64_t>();
+    const auto nameLength = reader.read<uint32_t>();
+    if (!reader.ok || nameLength > static_cast<size_t>(reader.end - reader.pos)) return false;
+    source.name.assign(reinterpret_cast<const char *>(reader.pos), nameLength);
+    reader.pos += nameLength;
+  }
+
+  data = file + dataOffset;
+  return reader.ok;
+}
+
+/**
+ *  @brief Generates the mip chain of every layer, each layer is downsampled and compressed by its own job.
+ **/
+void TextureCache::bake(const std::string &path, const std::vector<SourceFile> &bakedSources, uint32_t layerSize,
+                        uint32_t layers, const std::vector<uint8_t> &pixels, JobSystem &jobSystem) {
+  PROFILE_ZONE("bakeTextureCache");
+  close();
+
+  uint32_t levelCount = 1;
+  while ((layerSize >> levelCount) > 0) levelCount++;
+
+  std::vector<Level> levelTable(levelCount);
+  uint64_t dataBytes = 0;
+  uint32_t levelSize = layerSize;
+  for (Level &level: levelTable) {
+    level.size = levelSize;
+    level.offset = dataBytes;
+    level.bytes = static_cast<uint64_t>(blocksAcross(levelSize)) * blocksAcross(levelSize) * BLOCK_BYTES * layers;
+    dataBytes += level.bytes;
+    levelSize = std::max(levelSize / 2, 1u);
+  }
+
+  std::vector<uint8_t> out;
+  out.insert(out.end(), CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+  put(out, CACHE_VERSION);
+  put(out, FORMAT_BC1);
+  put(out, layerSize);
+  put(out, layers);
+  put(out, levelCount);
+  put(out, static_cast<uint32_t>(bakedSources.size()));
+  const size_t dataOffsetPosition = out.size();
+  put(out, uint32_t{0});
+  for (const Level &level: levelTable) {
+    put(out, level.offset);
+    put(out, level.bytes);
+  }
+  for (const SourceFile &source: bakedSources) {
+    put(out, source.size);
+    put(out, source.modified);
+    put(out, static_cast<uint32_t>(source.name.size()));
+    out.insert(out.end(), source.name.begin(), source.name.end());
+  }
+  out.resize((out.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT, 0);
+  const auto dataOffset = static_cast<uint32_t>(out.size());
+  std::memcpy(out.data() + dataOffsetPosition, &dataOffset, sizeof(uint32_t));
+  out.resize(out.size() + dataBytes);
+
+  uint8_t *blocks = out.data() + dataOffset;
+  const size_t layerBytes = static_cast<size_t>(layerSize) * layerSize * 4;
+  std::vector<JobHandle> jobs;
+  jobs.reserve(layers);
+  for (uint32_t layer = 0; layer < layers; ++layer) {
+    jobs.push_back(jobSystem.schedule([&, layer] {
+      PROFILE_ZONE("compressTexture");
+      std::vector<uint8_t> current(pixels.begin() + static_cast<ptrdiff_t>(layerBytes * layer),
+                                   pixels.begin() + static_cast<ptrdiff_t>(layerBytes * (layer + 1)));
+      std::vector<uint8_t> next;
+      for (const Level &level: levelTable) {
+        const uint64_t layerLevelBytes = level.bytes / layers;
+        encodeLevel(current.data(), level.size, blocks + level.offset + layerLevelBytes * layer);
+
+        const uint32_t nextSize = std::max(level.size / 2, 1u);
+        next.resize(static_cast<size_t>(nextSize) * nextSize * 4);
+        downsample(current.data(), level.size, next.data());
+        current.swap(next);
+      }
+    }));
+  }
+  for (const JobHandle &job: jobs) jobSystem.wait(job);
+
+  // Written next to it first, a crash never leaves a half written cache behind
+  const std::string tempPath = path + ".tmp";
+  std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+  file.close();
+
+  std::error_code error;
+  if (file) std::filesystem::rename(tempPath, path, error);
+  if (!file || error) {
+    LOG(W, "Failed to write the texture cache " << path << ", the textures get decoded again next start");
+    std::filesystem::remove(tempPath, error);
+  } else {
+    LOG(I, "Baked " << layers << " textures into " << path << " (" << out.size() / 1024 << " KiB)");
+  }
+
+  baked = std::move(out);
+  view = baked.data();
+  viewSize = baked.size();
+  parse(view, viewSize);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+/**
+ *  @brief Baked texture array, every layer with its full mip chain compressed to BC1 blocks.
+ *  The file starts with a header, the mip level table and the source files the cache was baked from, followed by the
+ *  block data at a 16 byte aligned offset. A level holds the blocks of all layers one after another, so the whole data
+ *  section is copied into a staging buffer as is and each level is a single buffer to image copy.
+ *  Opened caches are memory mapped, a cache is stale once a source file was added, removed or modified.
+ **/
+class TextureCache {
+public:
+  // Identifies a file in res/texture, a changed size or modification time invalidates the cache
+  struct SourceFile {
+    std::string name;
+    uint64_t size;
+    int64_t modified;
+
+    bool operator==(const SourceFile &other) const {
+      return name == other.name && size == other.size && modified == other.modified;
+    }
+  };
+
+  struct Level {
+    uint32_t size;
+    // Relative to the data section, covers every layer
+    uint64_t offset;
+    uint64_t bytes;
+  };
+
+  TextureCache() = default;
+  ~TextureCache();
+
+  TextureCache(const TextureCache &) = delete;
+  TextureCache &operator=(const TextureCache &) = delete;
+
+  // Maps the cache at path, false if it is missing, damaged or wasn't baked from sources
+  bool open(const std::string &path, const std::vector<SourceFile> &sources);
+  void close();
+
+  /**
+   *  @brief Compresses layers (RGBA8, size x size each) on the job system and keeps the result in memory.
+   *  Writes it to path for the next start, a failed write only costs the decode next time.
+   **/
+  void bake(const std::string &path, const std::vector<SourceFile> &sources, uint32_t size, uint32_t layerCount,
+            const std::vector<uint8_t> &layers, JobSystem &jobSystem);
+
+  [[nodiscard]] bool isLoaded() const { return data != nullptr; }
+  [[nodiscard]] uint32_t getSize() const { return size; }
+  [[nodiscard]] uint32_t getLayerCount() const { return layerCount; }
+  [[nodiscard]] const std::vector<Level> &getLevels() const { return levels; }
+  [[nodiscard]] const std::vector<SourceFile> &getSources() const { return sources; }
+
+  [[nodiscard]] const uint8_t *getData() const { return data; }
+  [[nodiscard]] size_t getDataSize() const { return dataSize; }
+
+  // Bytes of a BC1 block, it covers 4x4 texels
+  static constexpr uint32_t BLOCK_BYTES = 8;
+
+private:
+  bool parse(const uint8_t *file, size_t fileSize);
+  void unmap();
+
+  uint32_t size{0};
+  uint32_t layerCount{0};
+  std::vector<Level> levels;
+  std::vector<SourceFile> sources;
+
+  const uint8_t *data{nullptr};
+  size_t dataSize{0};
+
+  // Either the mapped file or the baked bytes
+  const uint8_t *view{nullptr};
+  size_t viewSize{0};
+  std::vector<uint8_t> baked;
+};
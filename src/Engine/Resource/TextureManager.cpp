@@ -0,0 +1,368 @@
+#include "TextureManager.h"
+
+#include "Engine.h"
+#include "Buffer/Buffer.h"
+#include "Logging/Profiler.hpp"
+#include "Threading/JobSystem.hpp"
+#include "VulkanPipeline/Pipeline/Commandbuffer.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+static constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+// Format of the baked cache, one bit alpha is enough for cutout textures
+static constexpr VkFormat COMPRESSED_FORMAT = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+// Size of the checkerboard if there are no textures at all
+static constexpr uint32_t MISSING_SIZE = 16;
+
+/**
+ *  @brief Nearest neighbour, keeps the pixels of small block textures sharp when they are scaled up.
+ **/
+static void scaleNearest(const std::vector<uint8_t> &src, uint32_t srcWidth, uint32_t srcHeight, uint32_t size,
+                         uint8_t *dst) {
+  for (uint32_t y = 0; y < size; ++y) {
+    const uint32_t srcY = y * srcHeight / size;
+    for (uint32_t x = 0; x < size; ++x) {
+      const uint32_t srcX = x * srcWidth / size;
+      std::memcpy(dst + (y * size + x) * 4, src.data() + (srcY * srcWidth + srcX) * 4, 4);
+    }
+  }
+}
+
+static void fillMissing(uint32_t size, uint8_t *dst) {
+  const uint32_t cell = std::max(size / 8, 1u);
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      const bool magenta = ((x / cell) + (y / cell)) % 2 == 0;
+      uint8_t *pixel = dst + (y * size + x) * 4;
+      pixel[0] = magenta ? 255 : 0;
+      pixel[1] = 0;
+      pixel[2] = magenta ? 255 : 0;
+      pixel[3] = 255;
+    }
+  }
+}
+
+static void imageBarrier(VkCommandBuffer cmdBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount,
+                         uint32_t layerCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage,
+                         VkPipelineStageFlags dstStage) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = baseLevel;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.layerCount = layerCount;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+/**
+ *  @brief Uploads the baked cache if it matches res/texture, otherwise decodes every png on the job system and bakes
+ *  a new cache for the next start. Without BC1 support the pngs are uploaded uncompressed and mipmapped on the gpu.
+ **/
+void TextureManager::init(JobSystem &jobSystem) {
+  PROFILE_ZONE("loadTextures");
+
+  std::vector<TextureCache::SourceFile> sources;
+  std::error_code error;
+  for (const auto &entry: std::filesystem::directory_iterator(TEXTURE_PATH, error)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".png") continue;
+    std::error_code stampError;
+    const uint64_t fileSize = entry.file_size(stampError);
+    const int64_t modified = entry.last_write_time(stampError).time_since_epoch().count();
+    sources.push_back({entry.path().filename().string(), stampError ? 0 : fileSize, stampError ? 0 : modified});
+  }
+  if (error) LOG(W, "Could not list " << TEXTURE_PATH << ": " << error.message());
+
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(vki.physicalDevice, &properties);
+  const uint32_t maxLayers = std::min(MAX_LAYERS, properties.limits.maxImageArrayLayers);
+
+  // Sorted so the layers don't depend on the directory order
+  std::sort(sources.begin(), sources.end(), [](const TextureCache::SourceFile &a, const TextureCache::SourceFile &b) {
+    return a.name < b.name;
+  });
+  if (sources.size() >= maxLayers) {
+    LOG(W, "Only " << maxLayers - 1 << " of " << sources.size() << " textures fit into the texture array");
+    sources.resize(maxLayers - 1);
+  }
+
+  layers.emplace("missing", MISSING_LAYER);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    layers.emplace(std::filesystem::path(sources[i].name).stem().string(), static_cast<uint32_t>(i + 1));
+  }
+
+  VkFormatProperties compressedProperties{};
+  vkGetPhysicalDeviceFormatProperties(vki.physicalDevice, COMPRESSED_FORMAT, &compressedProperties);
+  const bool compressed = vki.textureCompressionBC &&
+                          (compressedProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+  TextureCache cache{};
+  if (compressed && cache.open(CACHE_PATH, sources) && cache.getLayerCount() == sources.size() + 1) {
+    uploadCompressed(cache);
+    LOG(I, "Loaded " << layerCount << " textures of " << size << "x" << size << " from " << CACHE_PATH);
+    return;
+  }
+
+  std::vector<DecodedTexture> textures = decode(sources, jobSystem);
+  size = 0;
+  for (const DecodedTexture &texture: textures) size = std::max({size, texture.width, texture.height});
+  if (size == 0) size = MISSING_SIZE;
+  layerCount = static_cast<uint32_t>(textures.size());
+
+  std::vector<uint8_t> pixels = packLayers(textures);
+  if (compressed) {
+    cache.bake(CACHE_PATH, sources, size, layerCount, pixels, jobSystem);
+    uploadCompressed(cache);
+  } else {
+    upload(pixels);
+  }
+  LOG(I, "Loaded " << layerCount << " textures of " << size << "x" << size << " with " << mipLevels << " mips");
+}
+
+std::vector<TextureManager::DecodedTexture> TextureManager::decode(const std::vector<TextureCache::SourceFile> &sources,
+                                                                   JobSystem &jobSystem) {
+  std::vector<DecodedTexture> textures(sources.size() + 1);
+  textures[MISSING_LAYER].name = "missing";
+
+  // Global stb state, set before any job decodes
+  stbi_set_flip_vertically_on_load(true);
+
+  std::vector<JobHandle> jobs;
+  jobs.reserve(sources.size());
+  for (size_t i = 0; i < sources.size(); ++i) {
+    DecodedTexture &texture = textures[i + 1];
+    texture.name = std::filesystem::path(sources[i].name).stem().string();
+
+    jobs.push_back(jobSystem.schedule([&texture, path = TEXTURE_PATH + sources[i].name] {
+      PROFILE_ZONE("decodeTexture");
+      int width = 0, height = 0, channels = 0;
+      stbi_uc *pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+      if (pixels == nullptr) return;
+
+      texture.width = static_cast<uint32_t>(width);
+      texture.height = static_cast<uint32_t>(height);
+      texture.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+      stbi_image_free(pixels);
+    }));
+  }
+  for (const JobHandle &job: jobs) jobSystem.wait(job);
+
+  for (const DecodedTexture &texture: textures) {
+    if (&texture != &textures[MISSING_LAYER] && texture.pixels.empty()) {
+      LOG(W, "Could not load texture " << texture.name << ", it is drawn as missing");
+    }
+  }
+  return textures;
+}
+
+/**
+ *  @brief Scales every texture to size x size, the layers are packed one after another.
+ **/
+std::vector<uint8_t> TextureManager::packLayers(const std::vector<DecodedTexture> &textures) const {
+  const size_t layerSize = static_cast<size_t>(size) * size * 4;
+  std::vector<uint8_t> pixels(layerSize * textures.size());
+  for (size_t layer = 0; layer < textures.size(); ++layer) {
+    const DecodedTexture &texture = textures[layer];
+    uint8_t *dst = pixels.data() + layerSize * layer;
+    if (texture.pixels.empty()) {
+      fillMissing(size, dst);
+    } else {
+      scaleNearest(texture.pixels, texture.width, texture.height, size, dst);
+    }
+  }
+  return pixels;
+}
+
+void TextureManager::destroy() {
+  if (image == VK_NULL_HANDLE) return;
+
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  vkDestroyImageView(vki.device, view, nullptr);
+  vmaDestroyImage(vki.vmaAllocator, image, allocation);
+  image = VK_NULL_HANDLE;
+  layers.clear();
+}
+
+uint32_t TextureManager::getLayer(const std::string &name) const {
+  const auto layer = layers.find(name);
+  if (layer == layers.end()) {
+    LOG(W, "There is no texture " << name << ", using the missing texture");
+    return MISSING_LAYER;
+  }
+  return layer->second;
+}
+
+bool TextureManager::hasTexture(const std::string &name) const {
+  return layers.find(name) != layers.end();
+}
+
+void TextureManager::createImage(VkFormat format, VkImageUsageFlags usage) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = {size, size, 1};
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = layerCount;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  if (vmaCreateImage(vki.vmaAllocator, &imageInfo, &allocInfo, &image, &allocation, nullptr) != VK_SUCCESS)
+    LOG(F, "Failed to create the texture array");
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  viewInfo.format = format;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.levelCount = mipLevels;
+  viewInfo.subresourceRange.layerCount = layerCount;
+
+  if (vkCreateImageView(vki.device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+    LOG(F, "Failed to create the texture array view");
+}
+
+/**
+ *  @brief Copies all layers at once and blits the mip chain.
+ **/
+void TextureManager::upload(const std::vector<uint8_t> &pixels) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  mipLevels = 1;
+  while ((size >> mipLevels) > 0) mipLevels++;
+  // Every level is blitted from the one above
+  createImage(TEXTURE_FORMAT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+  Buffers::VmaBuffer stagingBuffer{};
+  Buffers::createBufferVMA(pixels.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           stagingBuffer.buffer, stagingBuffer.allocation);
+
+  void *data;
+  vmaMapMemory(vki.vmaAllocator, stagingBuffer.allocation, &data);
+  std::memcpy(data, pixels.data(), pixels.size());
+  vmaUnmapMemory(vki.vmaAllocator, stagingBuffer.allocation);
+
+  VkCommandBuffer cmdBuffer = Commandbuffer::recordSingleTime();
+  imageBarrier(cmdBuffer, image, 0, mipLevels, layerCount, VK_IMAGE_LAYOUT_UNDEFINED,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  // The layers are packed one after another, so a single region covers all of them
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.layerCount = layerCount;
+  region.imageExtent = {size, size, 1};
+  vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  generateMips(cmdBuffer);
+  Commandbuffer::endRecordSingleTime(cmdBuffer);
+
+  vmaDestroyBuffer(vki.vmaAllocator, stagingBuffer.buffer, stagingBuffer.allocation);
+}
+
+/**
+ *  @brief Copies the block data of the cache into staging memory as is, one region per mip level.
+ **/
+void TextureManager::uploadCompressed(const TextureCache &cache) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  size = cache.getSize();
+  layerCount = cache.getLayerCount();
+  mipLevels = static_cast<uint32_t>(cache.getLevels().size());
+  createImage(COMPRESSED_FORMAT, 0);
+
+  Buffers::VmaBuffer stagingBuffer{};
+  Buffers::createBufferVMA(cache.getDataSize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           stagingBuffer.buffer, stagingBuffer.allocation);
+
+  void *data;
+  vmaMapMemory(vki.vmaAllocator, stagingBuffer.allocation, &data);
+  std::memcpy(data, cache.getData(), cache.getDataSize());
+  vmaUnmapMemory(vki.vmaAllocator, stagingBuffer.allocation);
+
+  std::vector<VkBufferImageCopy> regions;
+  for (uint32_t level = 0; level < mipLevels; ++level) {
+    const TextureCache::Level &cacheLevel = cache.getLevels()[level];
+    VkBufferImageCopy region{};
+    region.bufferOffset = cacheLevel.offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.layerCount = layerCount;
+    // Levels smaller than a block still take up a whole one in the buffer
+    region.imageExtent = {cacheLevel.size, cacheLevel.size, 1};
+    regions.push_back(region);
+  }
+
+  VkCommandBuffer cmdBuffer = Commandbuffer::recordSingleTime();
+  imageBarrier(cmdBuffer, image, 0, mipLevels, layerCount, VK_IMAGE_LAYOUT_UNDEFINED,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+  vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()), regions.data());
+  imageBarrier(cmdBuffer, image, 0, mipLevels, layerCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  Commandbuffer::endRecordSingleTime(cmdBuffer);
+
+  vmaDestroyBuffer(vki.vmaAllocator, stagingBuffer.buffer, stagingBuffer.allocation);
+}
+
+/**
+ *  @brief Halves level after level for all layers at once, every level ends up shader readable.
+ **/
+void TextureManager::generateMips(VkCommandBuffer cmdBuffer) {
+  VkFormatProperties formatProperties{};
+  vkGetPhysicalDeviceFormatProperties(EngineData::i()->vkInstWrapper.physicalDevice, TEXTURE_FORMAT,
+                                      &formatProperties);
+  const VkFilter filter = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                          ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+  auto levelSize = static_cast<int32_t>(size);
+  for (uint32_t level = 1; level < mipLevels; ++level) {
+    imageBarrier(cmdBuffer, image, level - 1, 1, layerCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    const int32_t nextSize = std::max(levelSize / 2, 1);
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layerCount};
+    blit.srcOffsets[1] = {levelSize, levelSize, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layerCount};
+    blit.dstOffsets[1] = {nextSize, nextSize, 1};
+    vkCmdBlitImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+    imageBarrier(cmdBuffer, image, level - 1, 1, layerCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    levelSize = nextSize;
+  }
+
+  imageBarrier(cmdBuffer, image, mipLevels - 1, 1, layerCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
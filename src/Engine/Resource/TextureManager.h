@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include "TextureCache.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+
+/**
+ *  @brief Every texture of res/texture in a single 2D array image with a full mip chain.
+ *  Starts are served from the baked TextureCache, its BC1 blocks go to the gpu without decoding. If the cache is
+ *  missing or stale the files are decoded in parallel on the job system, scaled to the size of the largest one and
+ *  baked again. Layers are cached by file name without the extension, layer 0 is a checkerboard for textures that
+ *  are missing or failed to load. Block faces pick their layer through the texture field of the packed BlockVertex,
+ *  so all of them are drawn with one descriptor set.
+ **/
+class TextureManager {
+public:
+  // Width of the texture field in the packed BlockVertex
+  static constexpr uint32_t MAX_LAYERS = 512;
+  static constexpr uint32_t MISSING_LAYER = 0;
+
+  // STAGE: After the vma allocator and the command pool, the job system has to be running
+  void init(JobSystem &jobSystem);
+  void destroy();
+
+  // Layer of the texture called name, MISSING_LAYER if there is none
+  [[nodiscard]] uint32_t getLayer(const std::string &name) const;
+  [[nodiscard]] bool hasTexture(const std::string &name) const;
+
+  [[nodiscard]] VkImageView getView() const { return view; }
+  [[nodiscard]] uint32_t getLayerCount() const { return layerCount; }
+  [[nodiscard]] uint32_t getMipLevels() const { return mipLevels; }
+
+private:
+  struct DecodedTexture {
+    std::string name;
+    uint32_t width{0};
+    uint32_t height{0};
+    // RGBA8, empty if decoding failed
+    std::vector<uint8_t> pixels;
+  };
+
+  static std::vector<DecodedTexture> decode(const std::vector<TextureCache::SourceFile> &sources,
+                                            JobSystem &jobSystem);
+  [[nodiscard]] std::vector<uint8_t> packLayers(const std::vector<DecodedTexture> &textures) const;
+
+  void createImage(VkFormat format, VkImageUsageFlags usage);
+  // Uncompressed, the mips are generated on the gpu
+  void upload(const std::vector<uint8_t> &pixels);
+  void uploadCompressed(const TextureCache &cache);
+  void generateMips(VkCommandBuffer cmdBuffer);
+
+  VkImage image{};
+  VmaAllocation allocation{};
+  VkImageView view{};
+
+  uint32_t size{0};
+  uint32_t layerCount{0};
+  uint32_t mipLevels{0};
+
+  std::unordered_map<std::string, uint32_t> layers;
+
+  inline static const std::string TEXTURE_PATH = VOXLE_ROOT + std::string("/res/texture/");
+  // Next to the world directory, res stays read-only
+  inline static const std::string CACHE_PATH = "texture_cache.vxtc";
+};
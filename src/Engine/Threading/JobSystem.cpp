@@ -0,0 +1,169 @@
+#include "JobSystem.hpp"
+
+#include <Logging/Logger.h>
+#include <Logging/Profiler.hpp>
+
+// Index of the worker running on this thread, -1 for every other thread
+static thread_local int currentWorker = -1;
+
+JobSystem::~JobSystem() {
+  stop();
+}
+
+/**
+ *  @brief Starts the workers, this should only be called once.
+ **/
+void JobSystem::start(uint32_t workerCount) {
+  if (running) return;
+  if (workerCount == 0) workerCount = 1;
+
+  queues.clear();
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    queues.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  running = true;
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+
+  LOGF(I, "Started JobSystem with %u workers", workerCount);
+}
+
+/**
+ *  @brief Stops and joins all workers. Jobs that did not run yet are dropped.
+ **/
+void JobSystem::stop() {
+  if (!running) return;
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    running = false;
+  }
+  sleepSignal.notify_all();
+
+  for (std::thread &worker: workers) {
+    if (worker.joinable()) worker.join();
+  }
+  workers.clear();
+}
+
+/**
+ *  @brief Schedules the function, it runs as soon as every job in dependencies has finished.
+ *  Finished or empty dependency handles are ignored.
+ **/
+JobHandle JobSystem::schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies) {
+  auto job = std::make_shared<Job>();
+  job->function = std::move(function);
+
+  for (const JobHandle &dependency: dependencies) {
+    if (dependency == nullptr) continue;
+
+    std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+    if (dependency->finished) continue;
+    job->pendingDependencies++;
+    dependency->continuations.push_back(job);
+  }
+
+  // Drop the scheduling guard, runs right away if there are no pending dependencies
+  if (--job->pendingDependencies == 0) enqueue(job);
+  return job;
+}
+
+/**
+ *  @brief Blocks until the job finished. Executes other jobs in the meantime so waiting inside of a job can't deadlock.
+ **/
+void JobSystem::wait(const JobHandle &job) {
+  if (job == nullptr) return;
+
+  const uint32_t index = currentWorker >= 0 ? static_cast<uint32_t>(currentWorker) : 0;
+  while (!job->finished) {
+    if (JobHandle other = popOrSteal(index)) {
+      execute(other);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+uint32_t JobSystem::getWorkerCount() const {
+  return static_cast<uint32_t>(workers.size());
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+  currentWorker = static_cast<int>(index);
+  Profiler::setThreadName("Job worker " + std::to_string(index));
+
+  while (running) {
+    if (JobHandle job = popOrSteal(index)) {
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepSignal.wait(lock, [this] {
+      return pendingJobs > 0 || !running;
+    });
+  }
+}
+
+void JobSystem::enqueue(const JobHandle &job) {
+  // Workers keep their own work local, everyone else spreads it over all workers
+  const uint32_t index = currentWorker >= 0
+                         ? static_cast<uint32_t>(currentWorker)
+                         : nextQueue++ % static_cast<uint32_t>(queues.size());
+  {
+    WorkerQueue &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(job);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    pendingJobs++;
+  }
+  sleepSignal.notify_one();
+}
+
+JobHandle JobSystem::popOrSteal(uint32_t index) {
+  const auto count = static_cast<uint32_t>(queues.size());
+
+  // Own queue first, newest job
+  {
+    WorkerQueue &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      JobHandle job = std::move(own.jobs.back());
+      own.jobs.pop_back();
+      pendingJobs--;
+      return job;
+    }
+  }
+
+  // Steal the oldest job of another worker
+  for (uint32_t i = 1; i < count; ++i) {
+    WorkerQueue &victim = *queues[(index + i) % count];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || victim.jobs.empty()) continue;
+    JobHandle job = std::move(victim.jobs.front());
+    victim.jobs.pop_front();
+    pendingJobs--;
+    return job;
+  }
+
+  return nullptr;
+}
+
+void JobSystem::execute(const JobHandle &job) {
+  job->function();
+
+  std::vector<JobHandle> continuations;
+  {
+    std::lock_guard<std::mutex> lock(job->continuationMutex);
+    job->finished = true;
+    continuations.swap(job->continuations);
+  }
+
+  for (const JobHandle &continuation: continuations) {
+    if (--continuation->pendingDependencies == 0) enqueue(continuation);
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+/**
+ *  @brief A unit of work for the JobSystem, only runs once all of its dependencies finished.
+ **/
+struct Job {
+  std::function<void()> function;
+
+  // Unfinished dependencies + 1 while the job is still being scheduled
+  std::atomic<int> pendingDependencies{1};
+  std::atomic<bool> finished{false};
+
+  // Jobs that depend on this one
+  std::mutex continuationMutex;
+  std::vector<JobHandle> continuations;
+};
+
+/**
+ *  @brief Work stealing job scheduler.
+ *  Every worker owns a deque, it pops its own work from the back (LIFO, cache friendly) while idle workers
+ *  steal from the front of other deques (FIFO, oldest work first). Jobs scheduled from threads that are not
+ *  workers (main thread) are distributed round-robin.
+ **/
+class JobSystem {
+public:
+  ~JobSystem();
+
+  void start(uint32_t workerCount);
+  void stop();
+
+  JobHandle schedule(std::function<void()> function, const std::vector<JobHandle> &dependencies = {});
+  void wait(const JobHandle &job);
+
+  [[nodiscard]] uint32_t getWorkerCount() const;
+
+private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+  };
+
+  void workerLoop(uint32_t index);
+  void enqueue(const JobHandle &job);
+  JobHandle popOrSteal(uint32_t index);
+  void execute(const JobHandle &job);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+
+  std::atomic<bool> running{false};
+  std::atomic<uint32_t> pendingJobs{0};
+  std::atomic<uint32_t> nextQueue{0};
+
+  std::mutex sleepMutex;
+  std::condition_variable sleepSignal;
+};
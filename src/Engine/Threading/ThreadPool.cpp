@@ -2,7 +2,7 @@
 
 #include <Logging/Logger.h>
 
-#include "Engine.h"
+#include <algorithm>
 
 void ThreadPool::LogicThreading() {
   while (true) {
@@ -27,29 +27,6 @@ void ThreadPool::LogicThreading() {
   }
 }
 
-std::mutex builderMutex;
-std::condition_variable builderSignal;
-
-void ThreadPool::Builder() {
-  static ChunkHandler &chunkHandler = EngineData::i()->chunkHandler;
-  std::deque<glm::ivec3> *chunkGenList = chunkHandler.getChunkGenQueue();
-
-  while (true) {
-    std::unique_lock<std::mutex> lock(builderMutex);
-
-    // Sleep this thread if chunkGenList is empty or not signaled
-    builderSignal.wait(lock, [chunkGenList] {
-      return !chunkGenList->empty();
-    });
-
-    glm::ivec3 pos = chunkGenList->front();
-    chunkGenList->pop_front();
-
-    chunkHandler.generateChunk(pos);
-  }
-
-}
-
 void ThreadPool::RenderThreading() {
   while (true) {
     std::function<void()> currentJob;
@@ -125,22 +102,49 @@ void ThreadPool::start(const ThreadSet set, uint32_t threadOverride = 0) {
   }
 
   logicThreads.clear();
-  meshThreads.clear();
   renderThreads.clear();
 
   for (uint8_t i = 0; i < numLogicThreads; ++i) {
     logicThreads.push_back(std::make_unique<std::thread>(&ThreadPool::LogicThreading, this));
   }
 
-  for (uint8_t i = 0; i < numMeshThreads; ++i) {
-    meshThreads.push_back(std::make_unique<std::thread>(&ThreadPool::Builder, this));
-  }
-
   for (uint32_t i = 0; i < numRenderThreads; ++i) {
     renderThreads.push_back(std::make_unique<std::thread>(&ThreadPool::RenderThreading, this));
   }
+
+  // Chunk generation runs on the job system, it gets every core the other threads and the main thread don't use
+  uint32_t numJobWorkers = numMeshThreads;
+  if (numJobWorkers == 0) {
+    const int spareThreads = static_cast<int>(num_thread_avail) - numLogicThreads - numRenderThreads - 1;
+    numJobWorkers = static_cast<uint32_t>(std::max(spareThreads, 1));
+  }
+  jobSystem.start(numJobWorkers);
+}
+
+/**
+ *  Stops all threads, queued functions and jobs that did not run yet are dropped.
+ **/
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> logicLock(logicMutex);
+    std::lock_guard<std::mutex> meshLock(meshMutex);
+    std::lock_guard<std::mutex> renderLock(renderMutex);
+    shouldTerminate = true;
+  }
+  logicMutexCond.notify_all();
+  meshMutexCond.notify_all();
+  renderMutexCond.notify_all();
+
+  for (auto &thread: logicThreads) {
+    if (thread->joinable()) thread->join();
+  }
+  for (auto &thread: renderThreads) {
+    if (thread->joinable()) thread->join();
+  }
+
+  jobSystem.stop();
 }
 
-void ThreadPool::signalBuilderThreads() {
-  builderSignal.notify_one();
+JobSystem &ThreadPool::getJobSystem() {
+  return jobSystem;
 }
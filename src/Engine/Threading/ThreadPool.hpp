@@ -7,6 +7,7 @@
 #include <thread>
 #include <queue>
 #include "vulkan/vulkan_core.h"
+#include "JobSystem.hpp"
 
 namespace VulkanThread {
 
@@ -22,6 +23,7 @@ namespace VulkanThread {
 
 struct ThreadSet {
   uint8_t logicThreads;
+  // Workers of the JobSystem, 0 uses every core not taken by logic and render threads
   uint8_t meshThreads;
   uint8_t renderThreads;
 };
@@ -37,14 +39,15 @@ public:
 
   void start(ThreadSet set, uint32_t threadOverride);
 
-  void signalBuilderThreads();
+  void stop();
 
   void queueFunction(ThreadType type, const std::function<void()>& function);
 
+  JobSystem& getJobSystem();
+
 private:
 
   void LogicThreading();
-  void Builder();
   void RenderThreading();
 
   bool shouldTerminate = false;
@@ -59,10 +62,11 @@ private:
   std::condition_variable renderMutexCond;
 
   std::vector<std::unique_ptr<std::thread>> logicThreads;
-  std::vector<std::unique_ptr<std::thread>> meshThreads;
   std::vector<std::unique_ptr<std::thread>> renderThreads;
 
   std::queue<std::function<void()>> functionsQueuedLogic;
   std::queue<std::function<void()>> functionsQueuedMeshing;
   std::queue<std::function<void()>> functionsQueuedRender;
+
+  JobSystem jobSystem{};
 };
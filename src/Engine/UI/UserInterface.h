@@ -7,6 +7,7 @@
 #include <Logging/Logger.h>
 #include "../VulkanPipeline/Pipeline/GraphicsPipeline.h"
 #include <Logging/RenderTimings.h>
+#include <Logging/Profiler.hpp>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -14,9 +15,11 @@
 #include "Voxelate.h"
 
 #include "World/Chunk.hpp"
+#include "World/ChunkMesher.hpp"
 #include "Util/Util.hpp"
 
 #include <array>
+#include <cfloat>
 
 bool displayFrameProfiler = true;
 bool displayMainMenuBar = false;
@@ -99,10 +102,75 @@ namespace UI {
       ImGui::SetWindowPos(ImVec2(3, 27));
       ImGui::Text("Render Profiler");
       ImGui::TextColored(profiler.timingPerfIndicatorColor(), profiler.metrics().c_str());
+
+      // Percentiles over the last frames, the average above hides the spikes
+      const Profiler::FrameStats stats = Profiler::getFrameStats();
+      ImGui::Text("p50 %.2f ms | p99 %.2f ms | max %.2f ms", stats.p50Ms, stats.p99Ms, stats.maxMs);
+      const std::vector<float> histogram = Profiler::getFrameHistogram(1.0f, 40);
+      ImGui::PlotHistogram("##FrameTimes", histogram.data(), static_cast<int>(histogram.size()), 0,
+                           "frame time, 1 ms bins", 0.0f, FLT_MAX, ImVec2(240, 48));
+
+      for (const GpuProfiler::ZoneTime &zone: EngineData::i()->vkInstWrapper.gpuProfiler.getZoneTimes()) {
+        ImGui::Text("gpu %s: %.3f ms", zone.name, zone.ms);
+      }
+      ImGui::Text("P writes voxle_trace.json");
     }
     ImGui::End();
   }
 
+  // Compares the meshing modes, toggle with M
+  void renderMeshingStats() {
+    ImGui::NewLine();
+    ImGui::Text("Mesher: %s (M to toggle)", ChunkMesher::getModeName(ChunkMesher::getMode()));
+
+    for (MeshingMode mode: {MeshingMode::NAIVE, MeshingMode::GREEDY, MeshingMode::BINARY}) {
+      ChunkMesher::MeshingStats &stats = ChunkMesher::getStats(mode);
+      uint64_t chunks = stats.chunks.load();
+      if (chunks == 0) continue;
+      ImGui::Text("%s: %llu chunks | %.0f verts/chunk | %.3f ms/chunk", ChunkMesher::getModeName(mode),
+                  (unsigned long long) chunks,
+                  (double) stats.vertices.load() / (double) chunks,
+                  (double) stats.nanoseconds.load() / (double) chunks / 1000000.0);
+    }
+  }
+
+  void renderCullingStats() {
+    const ChunkDrawList &drawList = EngineData::i()->vkInstWrapper.chunkDrawList;
+    const GpuChunkCuller &culler = EngineData::i()->vkInstWrapper.gpuChunkCuller;
+    ImGui::NewLine();
+    if (culler.isActive()) {
+      // The gpu count is read back a frame late
+      const uint32_t visible = std::min(culler.getDrawnChunks() + culler.getOccludedChunks(), culler.getChunkCount());
+      ImGui::Text("Chunks drawn: %u | frustum culled: %u | occluded: %u (gpu)", culler.getDrawnChunks(),
+                  culler.getChunkCount() - visible, culler.getOccludedChunks());
+    } else {
+      ImGui::Text("Chunks drawn: %u | frustum culled: %u", drawList.getDrawnChunks(), drawList.getFrustumCulledChunks());
+      if (EngineData::i()->vkInstWrapper.caveCuller.isEnabled()) {
+        ImGui::Text("Cave culled: %u | visited: %u", drawList.getCaveCulledChunks(),
+                    EngineData::i()->vkInstWrapper.caveCuller.getVisitedChunks());
+      }
+    }
+  }
+
+  void renderMemoryStats() {
+    const ChunkEvictor &evictor = EngineData::i()->chunkEvictor;
+    const double mib = 1024.0 * 1024.0;
+    ImGui::NewLine();
+    ImGui::Text("Chunk RAM: %.1f / %.0f MiB | VRAM: %.1f / %.0f MiB", evictor.getRamUsage() / mib,
+                evictor.getRamBudget() / mib, evictor.getVramUsage() / mib, evictor.getVramBudget() / mib);
+    ImGui::Text("Chunks evicted: %llu | pending gpu frees: %zu", (unsigned long long) evictor.getEvictedChunks(),
+                EngineData::i()->vkInstWrapper.deletionQueue.size());
+
+    RegionStorage &regionStorage = EngineData::i()->regionStorage;
+    ImGui::Text("Chunks loaded: %llu | saved: %llu | pending writes: %zu",
+                (unsigned long long) regionStorage.getLoadedChunks(),
+                (unsigned long long) regionStorage.getSavedChunks(), regionStorage.getPendingWrites());
+
+    const ChunkHandler &ch = EngineData::i()->chunkHandler;
+    ImGui::Text("Uniform chunks: %llu | coarse misses: %llu", (unsigned long long) ch.getUniformChunks(),
+                (unsigned long long) ch.getCoarseMisses());
+  }
+
   void renderMainMenuBar() {
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
     ImGui::Begin("##MainMenuBarRect01", nullptr,
@@ -146,6 +214,7 @@ namespace UI {
   }
 
   void renderMainInterface(Camera &cam) {
+    PROFILE_ZONE("ui");
 
     // Init new frame for ImGui
     ImGui_ImplVulkan_NewFrame();
@@ -174,6 +243,10 @@ namespace UI {
     ImGui::NewLine();
     ImGui::Text(Util::stringFromIVec3({x, y, z}).c_str());
 
+    renderMeshingStats();
+    renderCullingStats();
+    renderMemoryStats();
+
     ImGui::End();
 
     renderFrameProfiler();
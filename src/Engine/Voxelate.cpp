@@ -12,9 +12,12 @@
 #include <VulkanPipeline/VulkanDebug.h>
 
 #include <World/Chunk.hpp>
+#include <World/ChunkMesher.hpp>
 
 #include <Scene/SceneManager.h>
 
+#include <Logging/Profiler.hpp>
+
 static void callback_glfwWindowResized(GLFWwindow *window, int w, int h) {
   EngineData::i()->w_frameBuffer = w;
   EngineData::i()->h_frameBuffer = h;
@@ -38,6 +41,43 @@ static void callback_glfwKey(GLFWwindow *window, int key, int scancode, int acti
     }
   }
 
+  if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+    // Cycles Naive -> Greedy -> Binary
+    auto mode = static_cast<MeshingMode>((static_cast<int>(ChunkMesher::getMode()) + 1) % 3);
+    ChunkMesher::setMode(mode);
+    LOG(I, "Switched chunk meshing to " << ChunkMesher::getModeName(mode));
+  }
+
+  if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+    ChunkDrawList &drawList = EngineData::i()->vkInstWrapper.chunkDrawList;
+    drawList.setIndirect(!drawList.isIndirect());
+    LOG(I, "Chunk rendering: " << (drawList.isIndirect() ? "multi draw indirect" : "direct draws"));
+  }
+
+  if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+    GpuChunkCuller &culler = EngineData::i()->vkInstWrapper.gpuChunkCuller;
+    if (culler.isSupported()) {
+      culler.setEnabled(!culler.isActive());
+      LOG(I, "Chunk culling: " << (culler.isActive() ? "gpu" : "cpu"));
+    }
+  }
+
+  if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+    GpuChunkCuller &culler = EngineData::i()->vkInstWrapper.gpuChunkCuller;
+    culler.setOcclusionEnabled(!culler.isOcclusionEnabled());
+    LOG(I, "Chunk occlusion culling: " << (culler.isOcclusionEnabled() ? "on" : "off"));
+  }
+
+  if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+    CaveCuller &caveCuller = EngineData::i()->vkInstWrapper.caveCuller;
+    caveCuller.setEnabled(!caveCuller.isEnabled());
+    LOG(I, "Chunk cave culling: " << (caveCuller.isEnabled() ? "on" : "off"));
+  }
+
+  if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+    Profiler::exportTrace("voxle_trace.json");
+  }
+
   if (key == GLFW_KEY_B && action == GLFW_PRESS) {
     LOG(D, "Toggled Bounding Box Visualization");
 
@@ -52,15 +92,15 @@ static void callback_glfwKey(GLFWwindow *window, int key, int scancode, int acti
                                                                       {chunk->getPos().x, chunk->getPos().y,
                                                                        chunk->getPos().z});
 
-      int index{};
+      if (LOG_ENABLED(D)) {
+        int index{};
 
-      for (Vertex vert: boundingBoxDefinition.first) {
-        LOG(D, std::to_string(index) + " | " + Util::stringFromVec3(vert.pos));
-        index++;
+        for (Vertex vert: boundingBoxDefinition.first) {
+          LOG(D, std::to_string(index) + " | " + Util::stringFromVec3(vert.pos));
+          index++;
+        }
       }
 
-      index = 0;
-
       SceneManager::i()->curScene.meshesInScene.push_back(boundingBoxMesh);
     }
 
@@ -69,13 +109,19 @@ static void callback_glfwKey(GLFWwindow *window, int key, int scancode, int acti
 }
 
 void Voxelate::run() {
+  Profiler::setThreadName("Main");
+  voxle::logging::applyLevelsFromEnvironment();
   initWindow();
 
-  initVulkan();
-
-  ThreadSet threadSet{1, 1, 1};
+  // Mesh threads 0 lets the job system use every spare core
+  ThreadSet threadSet{1, 0, 1};
+  // Before the workers start generating
+  EngineData::i()->regionStorage.open("world");
+  // Before initVulkan, the textures are decoded on the job system
   EngineData::i()->threadPool.start(threadSet, 8);
 
+  initVulkan();
+
   initScene();
 
   initGui();
@@ -135,17 +181,21 @@ void Voxelate::initVulkan() {
 
   VkSetup::createSampler();
 
-  // TODO: Cache textures in map or something else so we can delete these after and free memory
-  VulkanImage::Image texture{};
-  Resources::createTexture(texture, "cobblestone.png");
+  TextureManager &textureManager = EngineData::i()->vkInstWrapper.textureManager;
+  textureManager.init(EngineData::i()->threadPool.getJobSystem());
+  ChunkMesher::setMaterialTexture(Materials::SOLID, textureManager.getLayer("cobblestone"));
 
   // Descriptors
   VkDescriptorSetLayout descriptorLayout = VkSetup::createDescriptorSetLayout();
   VkSetup::createDescriptorPool();
   VkSetup::createDescriptorSets();
-  VkSetup::populateDescriptors(texture.image);
+  VkSetup::populateDescriptors(textureManager.getView());
+  EngineData::i()->vkInstWrapper.chunkDrawList.init(MAX_FRAMES_IN_FLIGHT, 4096);
 
   VulkanPipeline::createDepthBufferingObjects();
+  EngineData::i()->vkInstWrapper.depthPyramid.init();
+  EngineData::i()->vkInstWrapper.gpuChunkCuller.init(MAX_FRAMES_IN_FLIGHT);
+  EngineData::i()->vkInstWrapper.gpuProfiler.init(MAX_FRAMES_IN_FLIGHT);
 
   // Renderpass creation
   // TODO: Abstraction
@@ -187,6 +237,11 @@ void Voxelate::initVulkan() {
   Commandbuffer::create();
 
   VulkanPipeline::createSyncObjects();
+
+  EngineData::i()->vkInstWrapper.uploadManager.init(64 * 1024 * 1024);
+  // 32MiB of vertices and 24MiB of indices to start with, grows when full
+  EngineData::i()->vkInstWrapper.chunkArena.init(4 * 1024 * 1024, 6 * 1024 * 1024);
+  EngineData::i()->chunkEvictor.setBudgets(1024ull * 1024 * 1024, 512ull * 1024 * 1024);
 }
 
 // Initializes the scene
@@ -210,55 +265,100 @@ void Voxelate::initGui() {
 const int renderDistance = 32;
 const int renderDistanceY = 2;
 
-float inline distanceSq(glm::vec3 &a, glm::vec3 &b) {
-  float dx = a.x - b.x;
-  float dy = a.y - b.y;
-  float dz = a.z - b.z;
-  return (dx * dx) + (dy * dy) + (dz * dz);
-}
-
 void Voxelate::update(float deltaTime) {
+  PROFILE_ZONE("update");
   cam.update(EngineData::i()->window, deltaTime);
 
-  // TODO: We need to multithread this
   ChunkHandler &ch = EngineData::i()->chunkHandler;
-  int x = cam.position.x / CHUNK_SIZE;
-  int y = cam.position.y / CHUNK_SIZE;
-  int z = cam.position.z / CHUNK_SIZE;
-  glm::vec3 camPos{x,y,z};
-  for (int xc = -renderDistance + x; xc < renderDistance + x; xc++) {
-    for (int yc = -renderDistanceY + y; yc < renderDistanceY + y; yc++) {
-      for (int zc = -renderDistance + z; zc < renderDistance + z; zc++) {
-        glm::vec3 pos{xc, yc, zc};
-
-        float distToChunkFromPlayer = distanceSq(pos, camPos);
-
-        if (distToChunkFromPlayer <= renderDistance + 2) {
+  const glm::vec3 camChunkPos = cam.position / static_cast<float>(CHUNK_SIZE);
+  const float rangeSq = renderDistance + 2;
+
+  // Chunks in range stay queued until they are generated, so only look for new ones once the queue got refocused
+  const int range = static_cast<int>(std::ceil(std::sqrt(rangeSq)));
+  EngineData::i()->vkInstWrapper.caveCuller.setRange(range + 1, renderDistanceY + 1);
+
+  if (ch.setFocus(camChunkPos, cam.direction, rangeSq)) {
+    PROFILE_ZONE("queueChunks");
+    const glm::ivec3 center = glm::floor(camChunkPos);
+
+    for (int xc = center.x - range; xc <= center.x + range; xc++) {
+      for (int yc = -renderDistanceY + center.y; yc < renderDistanceY + center.y; yc++) {
+        for (int zc = center.z - range; zc <= center.z + range; zc++) {
+          glm::ivec3 pos{xc, yc, zc};
+
+          // Same range test as the cancellation in setFocus
+          glm::vec3 offset = glm::vec3(pos) + 0.5f - camChunkPos;
+          if (glm::dot(offset, offset) > rangeSq) continue;
+
           // Check for existence or currently in queue
           if (ch.getChunk(pos) != nullptr || ch.isChunkInQueue(pos)) continue;
 
-          ch.addChunkToQueue({xc, yc, zc});
+          ch.addChunkToQueue(pos);
         }
       }
     }
   }
-//
-  for (Chunk *chunk: ch.getChunksGenerated()) {
-    if (chunk->isLoaded()) continue;
-    if (chunk->isChunkEmpty() || !chunk->isMeshed()) continue;
 
-    chunk->setChunkLoaded(true);
+  UploadManager &uploadManager = EngineData::i()->vkInstWrapper.uploadManager;
+
+  {
+    PROFILE_ZONE("uploadChunks");
+    for (Chunk *chunk: ch.takeChunksToUpload()) {
+      if (chunk->isLoaded()) continue;
+      // Empty and fully hidden chunks still decide what can be seen through them
+      EngineData::i()->vkInstWrapper.caveCuller.setChunk(chunk->getPos(), chunk->getVisibility());
+      if (!chunk->hasMesh()) continue;
+
+      chunk->setChunkLoaded(true);
+      chunk->setUploadPending(true);
+
+      // Face Construction done -> reserve space in the arena, the copies are batched into one submit
+      ChunkMesh &chunkMesh = chunk->getChunkMesh();
+      Mesh &mesh = chunkMesh.mesh;
+
+      MeshArena &arena = EngineData::i()->vkInstWrapper.chunkArena;
+      mesh.arenaHandle = arena.allocate(static_cast<uint32_t>(chunkMesh.vertices.size()),
+                                        static_cast<uint32_t>(chunkMesh.indices.size()));
+      const MeshAllocation &range = arena.get(mesh.arenaHandle);
+
+      uploadManager.upload(arena.getVertexBuffer(), sizeof(BlockVertex) * range.firstVertex,
+                           chunkMesh.vertices.data(), sizeof(BlockVertex) * range.vertexCount);
+      uploadManager.upload(arena.getIndexBuffer(), sizeof(uint32_t) * range.firstIndex,
+                           chunkMesh.indices.data(), sizeof(uint32_t) * range.indexCount);
+
+      mesh.meshRenderData.transformMatrix = glm::translate(glm::mat4(1), {chunk->getPos().x * CHUNK_SIZE,
+                                                                          chunk->getPos().y * CHUNK_SIZE,
+                                                                          chunk->getPos().z * CHUNK_SIZE});
+
+      const Point &localCenter = chunkMesh.boundingBox.getCenter();
+      mesh.bounds = AABB{Point{localCenter.x + chunk->getPos().x * CHUNK_SIZE,
+                               localCenter.y + chunk->getPos().y * CHUNK_SIZE,
+                               localCenter.z + chunk->getPos().z * CHUNK_SIZE},
+                         chunkMesh.boundingBox.getHalfWidth()};
+
+      // Only drawn once its data reached the gpu
+      uploadManager.onComplete([chunk] {
+        chunk->setUploadPending(false);
+        const Mesh &uploaded = chunk->getChunkMesh().mesh;
+        EngineData::i()->vkInstWrapper.chunkArena.markResident(uploaded.arenaHandle);
+        SceneManager::i()->curScene.meshesInScene.push_back(uploaded);
+        EngineData::i()->vkInstWrapper.gpuChunkCuller.setChunk(uploaded.arenaHandle, uploaded);
+      });
+    }
+  }
 
-    // Face Construction done -> create buffers in mesh struct
+  uploadManager.submit();
+  uploadManager.poll();
 
-    Mesh &mesh = chunk->getChunkMesh().mesh;
-    mesh.vertexBuffer = Buffers::createBlockVertexBuffer(chunk->getChunkMesh().vertices);
-    mesh.indexBuffer = Buffers::createIndexBuffer(chunk->getChunkMesh().indices);
-    mesh.meshRenderData.transformMatrix = glm::translate(glm::mat4(1), {chunk->getPos().x * CHUNK_SIZE,
-                                                                        chunk->getPos().y * CHUNK_SIZE,
-                                                                        chunk->getPos().z * CHUNK_SIZE});
+  // Far chunks and what is over the memory budgets
+  {
+    PROFILE_ZONE("evictChunks");
+    EngineData::i()->chunkEvictor.update(camChunkPos, rangeSq, renderDistanceY);
+  }
 
-    SceneManager::i()->curScene.meshesInScene.push_back(chunk->getChunkMesh().mesh);
+  // Holes left by freed meshes, a few meshes per frame
+  if (EngineData::i()->vkInstWrapper.chunkArena.shouldCompact()) {
+    EngineData::i()->vkInstWrapper.chunkArena.compact();
   }
 }
 
@@ -272,6 +372,7 @@ void Voxelate::loop() {
     deltaSeconds = (float) (newTimeStamp - timeStamp);
     timeStamp = newTimeStamp;
     EngineData::i()->frameProfiler.tick(deltaSeconds);
+    Profiler::markFrame();
 
     glfwPollEvents();
 
@@ -288,6 +389,16 @@ void Voxelate::loop() {
 }
 
 void Voxelate::clean() {
+  // Workers might still be generating chunks
+  EngineData::i()->threadPool.stop();
+
+  // Edits of chunks that are still loaded, then wait for the writer
+  RegionStorage &regionStorage = EngineData::i()->regionStorage;
+  for (Chunk *chunk: EngineData::i()->chunkHandler.getChunksGenerated()) {
+    if (chunk->isModified()) regionStorage.save(chunk);
+  }
+  regionStorage.close();
+
   //TODO: Destroy everything else """ATM""" THIS SHOULD BE OK BECAUSE WINDOWS CLEANS MEMORY AFTER AN EXE WAS CLOSED
   VulkanInstance &vki = EngineData::i()->vkInstWrapper;
   VkDevice &device = vki.device;
@@ -301,6 +412,16 @@ void Voxelate::clean() {
 
   VkSetup::cleanupOldSwapchain(device);
 
+  // Finishes outstanding uploads, their meshes still land in the scene and get freed below
+  vki.uploadManager.destroy();
+  vki.deletionQueue.flush();
+  vki.chunkArena.destroy();
+  vki.gpuChunkCuller.destroy();
+  vki.gpuProfiler.destroy();
+  vki.depthPyramid.destroy();
+  vki.chunkDrawList.destroy();
+  vki.textureManager.destroy();
+
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vmaDestroyBuffer(allocator, vki.uniformBuffers[i].buffer, nullptr);
   }
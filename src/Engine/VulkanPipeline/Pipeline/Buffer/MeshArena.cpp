@@ -0,0 +1,381 @@
+#include "MeshArena.h"
+
+#include "Engine.h"
+#include "VulkanPipeline/Pipeline/Commandbuffer.h"
+
+#include <algorithm>
+
+/**
+ *  @brief Forgets every allocation, everything before used stays allocated.
+ **/
+void RangeAllocator::reset(uint32_t newCapacity, uint32_t used) {
+  capacity = newCapacity;
+  freeSize = 0;
+  blocksByOffset.clear();
+  blocksBySize.clear();
+  if (used < capacity) insertBlock(used, capacity - used);
+}
+
+/**
+ *  @brief Returns the offset of size free elements or INVALID_OFFSET if there is no block big enough.
+ **/
+uint32_t RangeAllocator::allocate(uint32_t size) {
+  if (size == 0) return 0;
+
+  auto bestFit = blocksBySize.lower_bound(size);
+  if (bestFit == blocksBySize.end()) return INVALID_OFFSET;
+
+  const uint32_t offset = bestFit->second;
+  const uint32_t blockSize = bestFit->first;
+  eraseBlock(blocksByOffset.find(offset));
+
+  // Give the rest of the block back
+  if (blockSize > size) insertBlock(offset + size, blockSize - size);
+  return offset;
+}
+
+uint32_t RangeAllocator::allocateBelow(uint32_t size, uint32_t limit) {
+  if (size == 0) return INVALID_OFFSET;
+
+  for (auto block = blocksByOffset.begin(); block != blocksByOffset.end(); ++block) {
+    const uint32_t offset = block->first;
+    const uint32_t blockSize = block->second;
+    if (offset + size > limit) break;
+    if (blockSize < size) continue;
+
+    eraseBlock(block);
+    if (blockSize > size) insertBlock(offset + size, blockSize - size);
+    return offset;
+  }
+  return INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+  if (size == 0) return;
+
+  // Merge with the free block after
+  auto next = blocksByOffset.find(offset + size);
+  if (next != blocksByOffset.end()) {
+    size += next->second;
+    eraseBlock(next);
+  }
+
+  // Merge with the free block before
+  auto prev = blocksByOffset.lower_bound(offset);
+  if (prev != blocksByOffset.begin()) {
+    --prev;
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      eraseBlock(prev);
+    }
+  }
+
+  insertBlock(offset, size);
+}
+
+uint32_t RangeAllocator::getLargestFreeBlock() const {
+  return blocksBySize.empty() ? 0 : blocksBySize.rbegin()->first;
+}
+
+void RangeAllocator::insertBlock(uint32_t offset, uint32_t size) {
+  blocksByOffset.emplace(offset, size);
+  blocksBySize.emplace(size, offset);
+  freeSize += size;
+}
+
+void RangeAllocator::eraseBlock(std::map<uint32_t, uint32_t>::iterator block) {
+  auto range = blocksBySize.equal_range(block->second);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == block->first) {
+      blocksBySize.erase(it);
+      break;
+    }
+  }
+  freeSize -= block->second;
+  blocksByOffset.erase(block);
+}
+
+/**
+ *  @brief Creates the shared buffers, capacities are in vertices and indices.
+ *  STAGE: After the UploadManager
+ **/
+void MeshArena::init(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  UploadManager &uploadManager = EngineData::i()->vkInstWrapper.uploadManager;
+
+  // Transfer source so the arena can be copied when compacting or growing
+  vertexBuffer = uploadManager.createDeviceBuffer(sizeof(BlockVertex) * vertexCapacity,
+                                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  indexBuffer = uploadManager.createDeviceBuffer(sizeof(uint32_t) * indexCapacity,
+                                                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+  vertexRanges.reset(vertexCapacity);
+  indexRanges.reset(indexCapacity);
+
+  LOG(I, "Created MeshArena with " + std::to_string(vertexCapacity) + " vertices and "
+         + std::to_string(indexCapacity) + " indices");
+}
+
+void MeshArena::destroy() {
+  VmaAllocator &allocator = EngineData::i()->vkInstWrapper.vmaAllocator;
+  vmaDestroyBuffer(allocator, vertexBuffer.buffer, vertexBuffer.allocation);
+  vmaDestroyBuffer(allocator, indexBuffer.buffer, indexBuffer.allocation);
+  vertexBuffer = {};
+  indexBuffer = {};
+
+  allocations.clear();
+  handleUsed.clear();
+  handleResident.clear();
+  freeHandles.clear();
+  pendingMoves.clear();
+}
+
+/**
+ *  @brief Reserves space for a mesh and returns its handle, the arena grows if it is full.
+ *  Growing moves every mesh, so offsets have to be looked up with get after this.
+ **/
+uint32_t MeshArena::allocate(uint32_t vertexCount, uint32_t indexCount) {
+  uint32_t firstVertex = vertexRanges.allocate(vertexCount);
+  uint32_t firstIndex = indexRanges.allocate(indexCount);
+
+  if (firstVertex == RangeAllocator::INVALID_OFFSET || firstIndex == RangeAllocator::INVALID_OFFSET) {
+    if (firstVertex != RangeAllocator::INVALID_OFFSET) vertexRanges.free(firstVertex, vertexCount);
+    if (firstIndex != RangeAllocator::INVALID_OFFSET) indexRanges.free(firstIndex, indexCount);
+
+    relocate(std::max(vertexRanges.getCapacity() * 2, vertexRanges.getCapacity() + vertexCount),
+             std::max(indexRanges.getCapacity() * 2, indexRanges.getCapacity() + indexCount));
+
+    firstVertex = vertexRanges.allocate(vertexCount);
+    firstIndex = indexRanges.allocate(indexCount);
+  }
+
+  uint32_t handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+  } else {
+    handle = static_cast<uint32_t>(allocations.size());
+    allocations.emplace_back();
+    handleUsed.push_back(false);
+    handleResident.push_back(false);
+  }
+
+  allocations[handle] = {firstVertex, vertexCount, firstIndex, indexCount};
+  handleUsed[handle] = true;
+  handleResident[handle] = false;
+  return handle;
+}
+
+/**
+ *  @brief Gives the ranges of the mesh back right away, the gpu must not be using them anymore.
+ **/
+void MeshArena::free(uint32_t handle) {
+  if (handle >= allocations.size() || !handleUsed[handle]) return;
+
+  // A copy still reads the ranges, they are given back once it completed
+  bool moving = false;
+  for (PendingMove &move: pendingMoves) {
+    if (move.handle != handle) continue;
+    move.cancelled = true;
+    moving = true;
+  }
+
+  if (!moving) {
+    const MeshAllocation &allocation = allocations[handle];
+    vertexRanges.free(allocation.firstVertex, allocation.vertexCount);
+    indexRanges.free(allocation.firstIndex, allocation.indexCount);
+  }
+
+  allocations[handle] = {};
+  handleUsed[handle] = false;
+  handleResident[handle] = false;
+  freeHandles.push_back(handle);
+  compactStalled = false;
+}
+
+void MeshArena::markResident(uint32_t handle) {
+  if (handle < handleResident.size() && handleUsed[handle]) handleResident[handle] = true;
+}
+
+/**
+ *  @brief 0 if all free vertex space is one block, close to 1 if it is scattered into small holes.
+ **/
+float MeshArena::getFragmentation() const {
+  if (vertexRanges.getFreeSize() == 0) return 0.0f;
+  return 1.0f - static_cast<float>(vertexRanges.getLargestFreeBlock()) / static_cast<float>(vertexRanges.getFreeSize());
+}
+
+/**
+ *  @brief True if enough space is lost in holes that moving meshes pays off and the last step made progress.
+ **/
+bool MeshArena::shouldCompact() const {
+  if (!pendingMoves.empty() || compactStalled) return false;
+  return getFragmentation() > 0.5f && vertexRanges.getFreeSize() > vertexRanges.getCapacity() / 4;
+}
+
+/**
+ *  @brief Moves up to COMPACT_VERTEX_BUDGET vertices of the COMPACT_CANDIDATES meshes furthest back into holes
+ *  further to the front.
+ *  The copies go with the next upload batch, meshes are drawn from their old ranges until it completed. The old
+ *  ranges are given back through the DeletionQueue once no frame in flight can read them anymore.
+ **/
+void MeshArena::compact() {
+  if (!pendingMoves.empty()) return;
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  std::vector<uint32_t> live;
+  for (uint32_t handle = 0; handle < allocations.size(); ++handle) {
+    if (handleUsed[handle] && handleResident[handle]) live.push_back(handle);
+  }
+  std::sort(live.begin(), live.end(), [this](uint32_t a, uint32_t b) {
+    return allocations[a].firstVertex > allocations[b].firstVertex;
+  });
+
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  uint32_t budget = COMPACT_VERTEX_BUDGET;
+  if (live.size() > COMPACT_CANDIDATES) live.resize(COMPACT_CANDIDATES);
+
+  for (uint32_t handle: live) {
+    const MeshAllocation &from = allocations[handle];
+    if (from.vertexCount > budget) break;
+
+    MeshAllocation to = from;
+    const uint32_t firstVertex = vertexRanges.allocateBelow(from.vertexCount, from.firstVertex);
+    const uint32_t firstIndex = indexRanges.allocateBelow(from.indexCount, from.firstIndex);
+    if (firstVertex != RangeAllocator::INVALID_OFFSET) {
+      to.firstVertex = firstVertex;
+      vertexCopies.push_back({sizeof(BlockVertex) * from.firstVertex, sizeof(BlockVertex) * firstVertex,
+                              sizeof(BlockVertex) * from.vertexCount});
+      budget -= from.vertexCount;
+    }
+    if (firstIndex != RangeAllocator::INVALID_OFFSET) {
+      to.firstIndex = firstIndex;
+      indexCopies.push_back({sizeof(uint32_t) * from.firstIndex, sizeof(uint32_t) * firstIndex,
+                             sizeof(uint32_t) * from.indexCount});
+    }
+    if (to.firstVertex == from.firstVertex && to.firstIndex == from.firstIndex) continue;
+
+    pendingMoves.push_back({handle, from, to, false});
+  }
+
+  if (pendingMoves.empty()) {
+    compactStalled = true;
+    return;
+  }
+
+  // Source and destination ranges are both allocated, so nothing else writes them while the copy runs
+  vki.uploadManager.copy(vertexBuffer.buffer, vertexBuffer.buffer, vertexCopies);
+  vki.uploadManager.copy(indexBuffer.buffer, indexBuffer.buffer, indexCopies);
+  vki.uploadManager.onComplete([this] { finishMoves(); });
+}
+
+/**
+ *  @brief Points the moved meshes at their new ranges, runs once the copies of the last compact step completed.
+ **/
+void MeshArena::finishMoves() {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  for (const PendingMove &move: pendingMoves) {
+    if (move.cancelled) {
+      vertexRanges.free(move.from.firstVertex, move.from.vertexCount);
+      indexRanges.free(move.from.firstIndex, move.from.indexCount);
+      freeMovedRanges(move.to, move.from);
+      continue;
+    }
+
+    allocations[move.handle] = move.to;
+    // Frames in flight were recorded with the old ranges
+    vki.deletionQueue.push([this, move, layout = relocations] {
+      if (layout == relocations) freeMovedRanges(move.from, move.to);
+    });
+  }
+
+  LOG(D, "Compacted MeshArena, moved " + std::to_string(pendingMoves.size()) + " meshes");
+  pendingMoves.clear();
+  generation++;
+}
+
+/**
+ *  @brief Frees the vertex and index range of ranges where it differs from other.
+ **/
+void MeshArena::freeMovedRanges(const MeshAllocation &ranges, const MeshAllocation &other) {
+  if (ranges.firstVertex != other.firstVertex) vertexRanges.free(ranges.firstVertex, ranges.vertexCount);
+  if (ranges.firstIndex != other.firstIndex) indexRanges.free(ranges.firstIndex, ranges.indexCount);
+}
+
+/**
+ *  @brief Copies every live mesh tightly packed into new buffers of the given capacities.
+ **/
+void MeshArena::relocate(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  // Pending uploads still target the old buffers and frames in flight still read them. Flushing also finishes
+  // the moves of a compact step.
+  vki.uploadManager.flush();
+  vkDeviceWaitIdle(vki.device);
+
+  Buffers::VmaBuffer newVertexBuffer = vki.uploadManager.createDeviceBuffer(
+    sizeof(BlockVertex) * vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  Buffers::VmaBuffer newIndexBuffer = vki.uploadManager.createDeviceBuffer(
+    sizeof(uint32_t) * indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+  // Keep the current order so neighbouring chunks stay close in memory
+  std::vector<uint32_t> live;
+  for (uint32_t handle = 0; handle < allocations.size(); ++handle) {
+    if (handleUsed[handle]) live.push_back(handle);
+  }
+  std::sort(live.begin(), live.end(), [this](uint32_t a, uint32_t b) {
+    return allocations[a].firstVertex < allocations[b].firstVertex;
+  });
+
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  uint32_t vertexHead = 0;
+  uint32_t indexHead = 0;
+
+  for (uint32_t handle: live) {
+    MeshAllocation &allocation = allocations[handle];
+
+    if (allocation.vertexCount > 0) {
+      vertexCopies.push_back({sizeof(BlockVertex) * allocation.firstVertex, sizeof(BlockVertex) * vertexHead,
+                              sizeof(BlockVertex) * allocation.vertexCount});
+    }
+    if (allocation.indexCount > 0) {
+      indexCopies.push_back({sizeof(uint32_t) * allocation.firstIndex, sizeof(uint32_t) * indexHead,
+                             sizeof(uint32_t) * allocation.indexCount});
+    }
+
+    allocation.firstVertex = vertexHead;
+    allocation.firstIndex = indexHead;
+    vertexHead += allocation.vertexCount;
+    indexHead += allocation.indexCount;
+  }
+
+  if (!vertexCopies.empty() || !indexCopies.empty()) {
+    VkCommandBuffer cmdBuffer = Commandbuffer::recordSingleTime();
+    if (!vertexCopies.empty()) {
+      vkCmdCopyBuffer(cmdBuffer, vertexBuffer.buffer, newVertexBuffer.buffer,
+                      static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+    }
+    if (!indexCopies.empty()) {
+      vkCmdCopyBuffer(cmdBuffer, indexBuffer.buffer, newIndexBuffer.buffer,
+                      static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+    }
+    Commandbuffer::endRecordSingleTime(cmdBuffer);
+  }
+
+  vmaDestroyBuffer(vki.vmaAllocator, vertexBuffer.buffer, vertexBuffer.allocation);
+  vmaDestroyBuffer(vki.vmaAllocator, indexBuffer.buffer, indexBuffer.allocation);
+  vertexBuffer = newVertexBuffer;
+  indexBuffer = newIndexBuffer;
+
+  vertexRanges.reset(vertexCapacity, vertexHead);
+  indexRanges.reset(indexCapacity, indexHead);
+  generation++;
+  relocations++;
+  compactStalled = false;
+
+  LOG(I, "Relocated MeshArena, " + std::to_string(live.size()) + " meshes using " + std::to_string(vertexHead)
+         + "/" + std::to_string(vertexCapacity) + " vertices");
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Buffer.h"
+
+#include <map>
+#include <vector>
+
+/**
+ *  @brief Free-list sub-allocator over a range of elements, best fit with coalescing of neighbouring free blocks.
+ **/
+class RangeAllocator {
+public:
+  static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+  void reset(uint32_t capacity, uint32_t used = 0);
+
+  uint32_t allocate(uint32_t size);
+  // First fit that ends at or before limit, INVALID_OFFSET if there is none
+  uint32_t allocateBelow(uint32_t size, uint32_t limit);
+  void free(uint32_t offset, uint32_t size);
+
+  [[nodiscard]] uint32_t getCapacity() const { return capacity; }
+  [[nodiscard]] uint32_t getFreeSize() const { return freeSize; }
+  [[nodiscard]] uint32_t getLargestFreeBlock() const;
+
+private:
+  void insertBlock(uint32_t offset, uint32_t size);
+  void eraseBlock(std::map<uint32_t, uint32_t>::iterator block);
+
+  uint32_t capacity{0};
+  uint32_t freeSize{0};
+
+  // Free blocks by offset for coalescing and by size for the best fit search
+  std::map<uint32_t, uint32_t> blocksByOffset;
+  std::multimap<uint32_t, uint32_t> blocksBySize;
+};
+
+/**
+ *  @brief Where a mesh lives inside of the arena, in vertices and indices.
+ **/
+struct MeshAllocation {
+  uint32_t firstVertex{0};
+  uint32_t vertexCount{0};
+  uint32_t firstIndex{0};
+  uint32_t indexCount{0};
+};
+
+/**
+ *  @brief One vertex and one index buffer shared by every chunk mesh, so all chunks draw with a single bind.
+ *  Meshes are referenced by handle since compacting or growing the arena moves them. Growing copies everything at
+ *  once and stalls the device, compacting moves a few meshes per frame on the upload queue instead.
+ *  Only to be used from the main thread.
+ **/
+class MeshArena {
+public:
+  static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+  void init(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void destroy();
+
+  uint32_t allocate(uint32_t vertexCount, uint32_t indexCount);
+  void free(uint32_t handle);
+  // The upload of the mesh completed, only resident meshes are moved by compact
+  void markResident(uint32_t handle);
+
+  [[nodiscard]] const MeshAllocation &get(uint32_t handle) const { return allocations[handle]; }
+
+  [[nodiscard]] VkBuffer getVertexBuffer() const { return vertexBuffer.buffer; }
+  [[nodiscard]] VkBuffer getIndexBuffer() const { return indexBuffer.buffer; }
+
+  // Changes whenever meshes were moved
+  [[nodiscard]] uint64_t getGeneration() const { return generation; }
+
+  [[nodiscard]] float getFragmentation() const;
+  [[nodiscard]] bool shouldCompact() const;
+  void compact();
+
+private:
+  // Most vertices compact moves per step
+  static constexpr uint32_t COMPACT_VERTEX_BUDGET = 64 * 1024;
+  // Most meshes a step tries to move, bounds the search for holes
+  static constexpr size_t COMPACT_CANDIDATES = 256;
+
+  struct PendingMove {
+    uint32_t handle;
+    MeshAllocation from;
+    MeshAllocation to;
+    // The mesh was freed while its copy was in flight
+    bool cancelled;
+  };
+
+  void relocate(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void finishMoves();
+  void freeMovedRanges(const MeshAllocation &ranges, const MeshAllocation &other);
+
+  Buffers::VmaBuffer vertexBuffer{};
+  Buffers::VmaBuffer indexBuffer{};
+
+  RangeAllocator vertexRanges{};
+  RangeAllocator indexRanges{};
+
+  std::vector<MeshAllocation> allocations;
+  std::vector<bool> handleUsed;
+  std::vector<bool> handleResident;
+  std::vector<uint32_t> freeHandles;
+
+  // Copies of the last compact step that haven't completed yet
+  std::vector<PendingMove> pendingMoves;
+  // The last step found nothing to move, set until a mesh is freed
+  bool compactStalled{false};
+
+  uint64_t generation{0};
+  // Deferred frees of moved ranges are dropped once a relocation rebuilt the free lists
+  uint64_t relocations{0};
+};
@@ -0,0 +1,301 @@
+#include "UploadManager.h"
+
+#include "Engine.h"
+#include "Logging/Profiler.hpp"
+#include "VulkanPipeline/Queue/QueueHelper.h"
+
+#include <cstring>
+
+// Copy offsets into the ring are kept aligned to this
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+/**
+ *  @brief Creates the staging ring and the command pool on the transfer queue family.
+ *  STAGE: After Device and VmaAllocator
+ **/
+void UploadManager::init(VkDeviceSize size) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  QueueFamilyIndices indices = QueueHelper::findQueueFamilies(vki.physicalDevice, vki.surface);
+  const uint32_t uploadFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+
+  // Buffers written by the transfer queue and read by the graphics queue are shared between both families
+  queueFamilies = {indices.graphicsFamily.value()};
+  if (uploadFamily != indices.graphicsFamily.value()) queueFamilies.push_back(uploadFamily);
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = uploadFamily;
+  if (vkCreateCommandPool(vki.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    LOG(F, "Could not create VkCommandPool for uploads");
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // CPU_ONLY memory is host coherent, writes don't need to be flushed
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+  allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  VmaAllocationInfo allocationResult{};
+  if (vmaCreateBuffer(vki.vmaAllocator, &bufferInfo, &allocInfo, &staging.buffer, &staging.allocation,
+                      &allocationResult) != VK_SUCCESS) {
+    LOG(F, "Could not create the staging ring");
+  }
+
+  stagingMapped = static_cast<uint8_t *>(allocationResult.pMappedData);
+  stagingSize = size;
+  ringHead = 0;
+  ringTail = 0;
+
+  LOG(I, "Created UploadManager with " + std::to_string(size / (1024 * 1024)) + "MiB staging ring"
+         + (indices.transferFamily.has_value() ? " on a dedicated transfer queue" : " on the graphics queue"));
+}
+
+/**
+ *  @brief Waits for all uploads and frees every resource, pending callbacks still run.
+ **/
+void UploadManager::destroy() {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  flush();
+
+  for (Batch &batch: freeBatches) {
+    vkDestroyFence(vki.device, batch.fence, nullptr);
+  }
+  if (openBatch.fence != VK_NULL_HANDLE) vkDestroyFence(vki.device, openBatch.fence, nullptr);
+  freeBatches.clear();
+  openBatch = Batch{};
+
+  vkDestroyCommandPool(vki.device, commandPool, nullptr);
+  vmaDestroyBuffer(vki.vmaAllocator, staging.buffer, staging.allocation);
+  stagingMapped = nullptr;
+}
+
+/**
+ *  @brief Creates a device local buffer that can be the destination of an upload.
+ **/
+Buffers::VmaBuffer UploadManager::createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+  Buffers::VmaBuffer buffer{};
+  if (size == 0) {
+    LOG(W, "Buffer size cannot be 0");
+    return buffer;
+  }
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  if (queueFamilies.size() > 1) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+  } else {
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+
+  VmaAllocationCreateInfo allocInfo{};
+  allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  if (vmaCreateBuffer(EngineData::i()->vkInstWrapper.vmaAllocator, &bufferInfo, &allocInfo, &buffer.buffer,
+                      &buffer.allocation, nullptr) != VK_SUCCESS) {
+    LOG(F, "Could not create device local Buffer");
+  }
+  return buffer;
+}
+
+/**
+ *  @brief Copies data into the staging ring right away and records the copy into the open batch.
+ *  The data can be freed after this returns, dst must not be used by the gpu before onComplete fired.
+ **/
+void UploadManager::upload(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+  if (size == 0) return;
+
+  VkBufferCopy copyRegion{};
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+
+  if (size > stagingSize) {
+    // Too big for the ring, this gets its own staging buffer that lives as long as the batch
+    LOG(W, "Upload of " + std::to_string(size) + " bytes does not fit into the staging ring");
+
+    Buffers::VmaBuffer dedicated{};
+    Buffers::createBufferVMA(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             dedicated.buffer, dedicated.allocation);
+
+    void *mapped;
+    vmaMapMemory(EngineData::i()->vkInstWrapper.vmaAllocator, dedicated.allocation, &mapped);
+    memcpy(mapped, data, size);
+    vmaUnmapMemory(EngineData::i()->vkInstWrapper.vmaAllocator, dedicated.allocation);
+
+    Batch &batch = getOpenBatch();
+    vkCmdCopyBuffer(batch.cmdBuffer, dedicated.buffer, dst, 1, &copyRegion);
+    batch.dedicatedStaging.push_back(dedicated);
+    return;
+  }
+
+  // Allocating can submit the open batch when the ring is full, so the batch is fetched afterwards
+  copyRegion.srcOffset = allocateStaging(size);
+  memcpy(stagingMapped + copyRegion.srcOffset, data, size);
+
+  Batch &batch = getOpenBatch();
+  vkCmdCopyBuffer(batch.cmdBuffer, staging.buffer, dst, 1, &copyRegion);
+}
+
+void UploadManager::copy(VkBuffer src, VkBuffer dst, const std::vector<VkBufferCopy> &regions) {
+  if (regions.empty()) return;
+  vkCmdCopyBuffer(getOpenBatch().cmdBuffer, src, dst, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+/**
+ *  @brief The callback runs on the main thread (in poll) once every upload recorded so far is on the gpu.
+ **/
+void UploadManager::onComplete(std::function<void()> callback) {
+  getOpenBatch().callbacks.push_back(std::move(callback));
+}
+
+/**
+ *  @brief Submits every copy recorded since the last submit as one command buffer.
+ **/
+void UploadManager::submit() {
+  if (!openBatch.recording) return;
+  PROFILE_ZONE("uploadSubmit");
+
+  vkEndCommandBuffer(openBatch.cmdBuffer);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &openBatch.cmdBuffer;
+
+  if (vkQueueSubmit(EngineData::i()->vkInstWrapper.transferQueue, 1, &submitInfo, openBatch.fence) != VK_SUCCESS)
+    LOG(F, "Could not submit upload batch");
+
+  openBatch.recording = false;
+  openBatch.ringEnd = ringHead;
+  batchesInFlight.push_back(std::move(openBatch));
+  openBatch = Batch{};
+}
+
+/**
+ *  @brief Retires every batch the gpu finished, frees its ring space and runs its callbacks. Never blocks.
+ **/
+void UploadManager::poll() {
+  PROFILE_ZONE("uploadPoll");
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  // Batches finish in submission order, the first unfinished one ends the search
+  while (!batchesInFlight.empty() && vkGetFenceStatus(device, batchesInFlight.front().fence) == VK_SUCCESS) {
+    Batch batch = std::move(batchesInFlight.front());
+    batchesInFlight.pop_front();
+    retire(batch);
+  }
+}
+
+/**
+ *  @brief Submits the open batch and blocks until every upload finished.
+ **/
+void UploadManager::flush() {
+  submit();
+  while (!batchesInFlight.empty()) waitForOldestBatch();
+}
+
+size_t UploadManager::getBatchesInFlight() const {
+  return batchesInFlight.size();
+}
+
+/**
+ *  @brief Reserves size bytes in the ring and returns their offset, waits for old batches if the ring is full.
+ **/
+VkDeviceSize UploadManager::allocateStaging(VkDeviceSize size) {
+  while (true) {
+    VkDeviceSize position = (ringHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+    // Allocations never wrap around the end of the ring, skip to the start instead
+    if (position % stagingSize + size > stagingSize) {
+      position = (position / stagingSize + 1) * stagingSize;
+    }
+
+    if (position + size - ringTail <= stagingSize) {
+      ringHead = position + size;
+      return position % stagingSize;
+    }
+
+    waitForOldestBatch();
+  }
+}
+
+UploadManager::Batch &UploadManager::getOpenBatch() {
+  if (openBatch.recording) return openBatch;
+
+  VkDevice &device = EngineData::i()->vkInstWrapper.device;
+
+  if (!freeBatches.empty()) {
+    openBatch = std::move(freeBatches.back());
+    freeBatches.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &openBatch.cmdBuffer) != VK_SUCCESS)
+      LOG(F, "Could not allocate upload VkCommandBuffer");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &openBatch.fence) != VK_SUCCESS)
+      LOG(F, "Could not create upload VkFence");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(openBatch.cmdBuffer, &beginInfo);
+
+  openBatch.recording = true;
+  return openBatch;
+}
+
+void UploadManager::retire(Batch &batch) {
+  VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+
+  ringTail = batch.ringEnd;
+
+  for (Buffers::VmaBuffer &dedicated: batch.dedicatedStaging) {
+    vmaDestroyBuffer(vki.vmaAllocator, dedicated.buffer, dedicated.allocation);
+  }
+  for (std::function<void()> &callback: batch.callbacks) {
+    callback();
+  }
+
+  vkResetFences(vki.device, 1, &batch.fence);
+  vkResetCommandBuffer(batch.cmdBuffer, 0);
+
+  batch.dedicatedStaging.clear();
+  batch.callbacks.clear();
+  batch.ringEnd = 0;
+  freeBatches.push_back(std::move(batch));
+}
+
+/**
+ *  @brief Blocks until the oldest batch finished, only used when the ring ran out of space.
+ **/
+void UploadManager::waitForOldestBatch() {
+  // The open batch holds the ring, it has to be in flight before it can be waited on
+  if (batchesInFlight.empty()) submit();
+  if (batchesInFlight.empty()) {
+    ringTail = ringHead;
+    return;
+  }
+
+  Batch batch = std::move(batchesInFlight.front());
+  batchesInFlight.pop_front();
+  vkWaitForFences(EngineData::i()->vkInstWrapper.device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+  retire(batch);
+}
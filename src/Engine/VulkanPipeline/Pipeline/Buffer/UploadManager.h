@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Buffer.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ *  @brief Streams data into device local buffers through one persistently mapped staging ring.
+ *  Copies are collected into a single command buffer per batch and submitted to the transfer queue,
+ *  completion is tracked with a fence per batch so the cpu never waits for the queue to idle.
+ *  Only to be used from the main thread.
+ **/
+class UploadManager {
+public:
+  void init(VkDeviceSize stagingSize);
+  void destroy();
+
+  Buffers::VmaBuffer createDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+
+  void upload(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+  // Device to device, the source ranges must not be written until the batch completed
+  void copy(VkBuffer src, VkBuffer dst, const std::vector<VkBufferCopy> &regions);
+  void onComplete(std::function<void()> callback);
+
+  void submit();
+  void poll();
+  void flush();
+
+  [[nodiscard]] size_t getBatchesInFlight() const;
+
+private:
+  struct Batch {
+    VkCommandBuffer cmdBuffer{};
+    VkFence fence{};
+
+    // Ring position after the last copy of this batch, everything before is free once the fence signaled
+    VkDeviceSize ringEnd{0};
+    bool recording{false};
+
+    std::vector<std::function<void()>> callbacks;
+    // Uploads that did not fit into the ring at all
+    std::vector<Buffers::VmaBuffer> dedicatedStaging;
+  };
+
+  VkDeviceSize allocateStaging(VkDeviceSize size);
+  Batch &getOpenBatch();
+  void retire(Batch &batch);
+  void waitForOldestBatch();
+
+  VkCommandPool commandPool{};
+
+  Buffers::VmaBuffer staging{};
+  uint8_t *stagingMapped{nullptr};
+  VkDeviceSize stagingSize{0};
+
+  // Monotonic byte positions, the real offset is position % stagingSize
+  VkDeviceSize ringHead{0};
+  VkDeviceSize ringTail{0};
+
+  std::vector<uint32_t> queueFamilies;
+
+  Batch openBatch{};
+  std::deque<Batch> batchesInFlight;
+  std::vector<Batch> freeBatches;
+};
@@ -5,6 +5,7 @@
 #include "Scene/SceneManager.h"
 
 #include "Engine.h"
+#include "Logging/Profiler.hpp"
 #include "Util/ColorUtil.hpp"
 
 void VulkanPipeline::createFramebuffers() {
@@ -73,7 +74,8 @@ void VulkanPipeline::createDepthBufferingObjects() {
   // Create image
   VulkanImage::createImage(imgWidth, imgHeight, depthFormat,
                            VK_IMAGE_TILING_OPTIMAL,
-                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                           // Sampled to build the depth pyramid
+                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                            EngineData::i()->vkInstWrapper.depthImage.vkImage,
                            EngineData::i()->vkInstWrapper.depthImage.vkImageMemory);
@@ -91,7 +93,9 @@ void VulkanPipeline::createDepthBufferingObjects() {
 }
 
 void VulkanPipeline::recordCommandBuffer(Camera &cam, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  PROFILE_ZONE("recordCommandBuffer");
   VulkanInstance &vki = EngineData::i()->vkInstWrapper;
+  GpuProfiler &gpuProfiler = vki.gpuProfiler;
 
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -100,6 +104,8 @@ void VulkanPipeline::recordCommandBuffer(Camera &cam, VkCommandBuffer commandBuf
 
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
     LOG(F, "Could not start recording VkCommandBuffer");
+  // The fence of this frame signaled, its last timestamps can be read back
+  gpuProfiler.beginFrame(commandBuffer, vki.currentFrame);
 
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -129,15 +135,24 @@ void VulkanPipeline::recordCommandBuffer(Camera &cam, VkCommandBuffer commandBuf
   scissor.extent = EngineData::i()->vkInstWrapper.extent;
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
+  glm::mat4 view = cam.cameraMatrix.view;
+  glm::mat4 proj = cam.cameraMatrix.proj;
+
+  // Chunks outside of the view frustum are skipped, on the gpu if possible which also skips occluded chunks. The
+  // compute pass can't run inside the render pass
+  const Frustum frustum{proj * view};
+  const bool gpuCulling = vki.gpuChunkCuller.isActive();
+  if (gpuCulling) {
+    const GpuProfiler::Zone cullZone{gpuProfiler, commandBuffer, "chunkCull"};
+    vki.gpuChunkCuller.recordCull(commandBuffer, vki.currentFrame, proj * view);
+  }
+
   // Begins the renderPass with the specified renderPassInfo
   vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
   Mesh *lastRenderedMesh = nullptr;
   VulkanPipeline::Pipeline *lastUsedPipeline = nullptr;
 
-  glm::mat4 view = cam.cameraMatrix.view;
-  glm::mat4 proj = cam.cameraMatrix.proj;
-
   // ---- Render meshes ----
 
   // Bind the Pipeline to the commandBuffer
@@ -151,7 +166,52 @@ void VulkanPipeline::recordCommandBuffer(Camera &cam, VkCommandBuffer commandBuf
 
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline.getPipeline());
 
+  // Building can grow the draw data buffer, which rewrites the frames descriptor set. Has to happen before binding it.
+  uint32_t chunkDraws = 0;
+  if (!gpuCulling) {
+    // Chunks hidden behind solid terrain are found by walking the chunk visibility from the camera
+    const CaveCuller *caveCuller = nullptr;
+    if (vki.caveCuller.isEnabled()) {
+      vki.caveCuller.update(cam.position, frustum);
+      caveCuller = &vki.caveCuller;
+    }
+    chunkDraws = vki.chunkDrawList.build(vki.currentFrame, SceneManager::i()->curScene.meshesInScene, frustum,
+                                         caveCuller);
+  }
+
+  // Bind UBO, the chunk draw data lives in the frames own set
+  VkDescriptorSet &descriptorSet = vki.descriptorSets[vki.currentFrame];
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline.getPipelineLayout(), 0, 1,
+                          &descriptorSet, 0, nullptr);
+
+  // ---- Render chunks ----
+
+  // Every chunk is in the arena, the visible ones share one bind and one indirect draw. Offsets come from the draw data.
+  const uint32_t chunkZone = gpuProfiler.beginZone(commandBuffer, "chunks");
+  if (gpuCulling || chunkDraws > 0) {
+    MeshPushConstant chunkConstant{};
+    chunkConstant.transformMatrix = proj * view;
+    vkCmdPushConstants(commandBuffer, currentPipeline.getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(MeshPushConstant), &chunkConstant);
+
+    VkBuffer arenaVertexBuffer = vki.chunkArena.getVertexBuffer();
+    VkDeviceSize offsets = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &arenaVertexBuffer, &offsets);
+    vkCmdBindIndexBuffer(commandBuffer, vki.chunkArena.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    if (gpuCulling) {
+      vki.gpuChunkCuller.recordDraw(commandBuffer, vki.currentFrame);
+    } else {
+      vki.chunkDrawList.record(commandBuffer, vki.currentFrame, chunkDraws);
+    }
+  }
+  gpuProfiler.endZone(commandBuffer, chunkZone);
+
+  const uint32_t meshZone = gpuProfiler.beginZone(commandBuffer, "meshes");
+
   for (Mesh &m: SceneManager::i()->curScene.meshesInScene) {
+    // Already drawn above
+    if (m.arenaHandle != MeshArena::INVALID_HANDLE) continue;
 
     // Bind different pipeline if required
     if(m.shader != nullptr && lastUsedPipeline != m.shader) {
@@ -181,19 +241,29 @@ void VulkanPipeline::recordCommandBuffer(Camera &cam, VkCommandBuffer commandBuf
       vkCmdBindIndexBuffer(commandBuffer, m.indexBuffer.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
       lastRenderedMesh = &m;
     }
-    // Bind UBO
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, currentPipeline.getPipelineLayout(), 0, 1,
-                            vki.descriptorSets.data(), 0, nullptr);
 
     vkCmdDrawIndexed(commandBuffer, m.indexBuffer.indicesSize, 1, 0, 0, 0);
   }
 
   // ---- Render meshes End ----
+  gpuProfiler.endZone(commandBuffer, meshZone);
 
   // ImGUI Rendering TODO: Seperate into EngineUI class
-  ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+  {
+    const GpuProfiler::Zone uiZone{gpuProfiler, commandBuffer, "ui"};
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+  }
 
   vkCmdEndRenderPass(commandBuffer);
+
+  // The next frame rejects chunks hidden behind this frames depth
+  if (gpuCulling) {
+    const GpuProfiler::Zone pyramidZone{gpuProfiler, commandBuffer, "depthPyramid"};
+    vki.depthPyramid.recordBuild(commandBuffer);
+  } else {
+    vki.depthPyramid.invalidate();
+  }
+
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) LOG(F, "Could not end VkCommandBuffer recording");
 
 //  Mesh& m = SceneManager::i()->curScene.meshesInScene.at(1);
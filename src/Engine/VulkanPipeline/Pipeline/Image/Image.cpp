@@ -133,7 +133,7 @@ void VulkanImage::createImageView(VkImage image, VkImageView& imageView, VkForma
  *  repeatMode is for UV(W) tiling
  **/
 void VulkanImage::Sampler::createTextureSampler(VkSampler& sampler, VkFilter filter,
-                                                VkSamplerAddressMode repeatMode) {
+                                                VkSamplerAddressMode repeatMode, float maxLod) {
   VkSamplerCreateInfo samplerInfo{};
   samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   samplerInfo.magFilter = filter;
@@ -163,7 +163,7 @@ void VulkanImage::Sampler::createTextureSampler(VkSampler& sampler, VkFilter fil
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = 0.0f;
+  samplerInfo.maxLod = maxLod;
 
   if(vkCreateSampler(EngineData::i()->vkInstWrapper.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
     LOG(F, "Sampler could not be created (Image.cpp)");
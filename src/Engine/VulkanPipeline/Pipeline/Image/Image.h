@@ -26,7 +26,8 @@ namespace VulkanImage {
 
   namespace Sampler {
 
-    void createTextureSampler(VkSampler &sampler, VkFilter filter, VkSamplerAddressMode repeatMode);
+    void createTextureSampler(VkSampler &sampler, VkFilter filter, VkSamplerAddressMode repeatMode,
+                              float maxLod = 0.0f);
 
   }
 
@@ -27,5 +27,14 @@ QueueFamilyIndices QueueHelper::findQueueFamilies(const VkPhysicalDevice& device
     i++;
   }
 
+  i = 0;
+  for (const auto &queueFamily: queueFamilies) {
+    if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+      indices.transferFamily = i;
+      break;
+    }
+    i++;
+  }
+
   return indices;
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // Only set if the device has a transfer family without graphics, the copy engine of most discrete gpus
+  std::optional<uint32_t> transferFamily;
 
   bool hasBoth() {
     return graphicsFamily.has_value() && presentFamily.has_value();
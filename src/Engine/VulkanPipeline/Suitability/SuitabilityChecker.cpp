@@ -67,7 +67,8 @@ VkFormat SuitabilityChecker::getSupportedDepthFormat() {
   return SuitabilityChecker::findSupportedDepthFormat(
     {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
     VK_IMAGE_TILING_OPTIMAL,
-    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    // Sampled by the depth pyramid
+    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 bool SuitabilityChecker::hasDepthStencilComponent(VkFormat format) {
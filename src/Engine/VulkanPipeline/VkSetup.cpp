@@ -172,6 +172,7 @@ void VkSetup::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+  if (indices.transferFamily.has_value()) uniqueQueueFamilies.insert(indices.transferFamily.value());
 
   //Set the queue execution priority
   float queuePrio = 1.0f;
@@ -192,10 +193,41 @@ void VkSetup::createLogicalDevice() {
   // Enable device features
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = deviceFeaturesStruct.samplerAnisotropy;
+  deviceFeatures.multiDrawIndirect = deviceFeaturesStruct.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = deviceFeaturesStruct.drawIndirectFirstInstance;
+  // The baked texture cache is BC1 compressed, textures are uploaded uncompressed without it
+  deviceFeatures.textureCompressionBC = deviceFeaturesStruct.textureCompressionBC;
+
+  EngineData::i()->vkInstWrapper.multiDrawIndirect = deviceFeaturesStruct.multiDrawIndirect;
+  EngineData::i()->vkInstWrapper.drawIndirectFirstInstance = deviceFeaturesStruct.drawIndirectFirstInstance;
+  EngineData::i()->vkInstWrapper.textureCompressionBC = deviceFeaturesStruct.textureCompressionBC;
+
+  // drawIndirectCount is a Vulkan 1.2 feature, GPU culling falls back to the CPU without it
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  bool hasVulkan12 = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+
+  if (hasVulkan12) {
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    // Only enable what we use
+    VkBool32 drawIndirectCount = vulkan12Features.drawIndirectCount;
+    vulkan12Features = VkPhysicalDeviceVulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.drawIndirectCount = drawIndirectCount;
+  }
+  EngineData::i()->vkInstWrapper.drawIndirectCount = vulkan12Features.drawIndirectCount;
 
   // Create Logical Device Info
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = hasVulkan12 ? &vulkan12Features : nullptr;
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
@@ -211,6 +243,10 @@ void VkSetup::createLogicalDevice() {
   vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &EngineData::i()->vkInstWrapper.graphicsQueue);
   vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &EngineData::i()->vkInstWrapper.presentQueue);
 
+  // Uploads share the graphics queue if there is no dedicated transfer queue
+  vkGetDeviceQueue(device, indices.transferFamily.value_or(indices.graphicsFamily.value()), 0,
+                   &EngineData::i()->vkInstWrapper.transferQueue);
+
   EngineData::i()->vkInstWrapper.device = device;
   LOG(I, "Created Device Queues");
 }
@@ -315,7 +351,9 @@ void VkSetup::createImageViews() {
 
 void VkSetup::createSampler() {
   LOG(D, "Created Global Texture Sampler");
-  VulkanImage::Sampler::createTextureSampler(EngineData::i()->vkInstWrapper.mainSampler, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+  // Repeat so textures tile over greedy meshed quads, every mip of the texture array can be sampled
+  VulkanImage::Sampler::createTextureSampler(EngineData::i()->vkInstWrapper.mainSampler, VK_FILTER_NEAREST,
+                                             VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_LOD_CLAMP_NONE);
 }
 
 void VkSetup::recreateSwapchain(VkDevice &device) {
@@ -333,6 +371,7 @@ void VkSetup::recreateSwapchain(VkDevice &device) {
   createSwapchain(true);
   createImageViews();
   VulkanPipeline::createDepthBufferingObjects();
+  EngineData::i()->vkInstWrapper.depthPyramid.resize();
   VulkanPipeline::createFramebuffers();
 }
 
@@ -366,7 +405,16 @@ VkDescriptorSetLayout VkSetup::createDescriptorSetLayout() {
   samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
   samplerLayoutBinding.pImmutableSamplers = nullptr;
 
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  // Chunk draw data layout binding
+  VkDescriptorSetLayoutBinding chunkDrawLayoutBinding{};
+  chunkDrawLayoutBinding.binding = 2;
+  chunkDrawLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  chunkDrawLayoutBinding.descriptorCount = 1;
+  chunkDrawLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  chunkDrawLayoutBinding.pImmutableSamplers = nullptr;
+
+  std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding,
+                                                          chunkDrawLayoutBinding};
 
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -387,16 +435,18 @@ VkDescriptorSetLayout VkSetup::createDescriptorSetLayout() {
 void VkSetup::createDescriptorPool() {
   auto count = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
-  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  std::array<VkDescriptorPoolSize, 3> poolSizes{};
   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   poolSizes[0].descriptorCount = count;
   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
   poolSizes[1].descriptorCount = count;
+  poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[2].descriptorCount = count;
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.poolSizeCount = static_cast<int>(poolSizes.size());
-  poolInfo.maxSets = static_cast<int>(poolSizes.size());
+  poolInfo.maxSets = count;
   poolInfo.pPoolSizes = poolSizes.data();
 
   if (vkCreateDescriptorPool(EngineData::i()->vkInstWrapper.device, &poolInfo, nullptr,
@@ -424,7 +474,7 @@ void VkSetup::createDescriptorSets() {
   LOG(I, "Created VkDescriptorSets");
 }
 
-void VkSetup::populateDescriptors(VulkanImage::InternalImage& image) {
+void VkSetup::populateDescriptors(VkImageView textureView) {
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     VkDescriptorBufferInfo bufferInfo{};
     bufferInfo.buffer = EngineData::i()->vkInstWrapper.uniformBuffers[i].buffer;
@@ -433,7 +483,7 @@ void VkSetup::populateDescriptors(VulkanImage::InternalImage& image) {
 
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = image.vkImageView;
+    imageInfo.imageView = textureView;
     imageInfo.sampler = EngineData::i()->vkInstWrapper.mainSampler;
 
     std::array<VkWriteDescriptorSet, 2> writes{};
@@ -33,5 +33,5 @@ namespace VkSetup {
   void createDescriptorPool();
   void createDescriptorSets();
 
-  void populateDescriptors(VulkanImage::InternalImage& image);
+  void populateDescriptors(VkImageView textureView);
 }
@@ -6,7 +6,16 @@
 #include "GraphicsPipeline.h"
 
 #include "Buffer/Buffer.h"
+#include "Buffer/UploadManager.h"
+#include "Buffer/MeshArena.h"
+#include "Renderer/ChunkDrawList.h"
+#include "Renderer/GpuChunkCuller.h"
+#include "Renderer/DepthPyramid.h"
+#include "Renderer/CaveCuller.h"
+#include "Renderer/DeletionQueue.h"
+#include "Renderer/GpuProfiler.h"
 #include "Image/Image.h"
+#include "Resource/TextureManager.h"
 
 #include "vk_mem_alloc.h"
 
@@ -36,6 +45,13 @@ struct VulkanInstance {
 
   VkQueue graphicsQueue{};
   VkQueue presentQueue{};
+  VkQueue transferQueue{};
+
+  // Optional device features, enabled if supported
+  bool multiDrawIndirect{false};
+  bool drawIndirectFirstInstance{false};
+  bool drawIndirectCount{false};
+  bool textureCompressionBC{false};
 
   int currentFrame{0};
 
@@ -51,6 +67,8 @@ struct VulkanInstance {
 
   // Texturing
   VkSampler mainSampler;
+  // Block textures, sampled through the mainSampler
+  TextureManager textureManager{};
 
   VkExtent2D extent{};
   VkFormat format;
@@ -78,6 +96,23 @@ struct VulkanInstance {
   VkDescriptorPool descriptorPool;
   std::vector<VkDescriptorSet> descriptorSets;
 
+  // Streams mesh data to the gpu
+  UploadManager uploadManager{};
+  // Vertices and indices of every chunk
+  MeshArena chunkArena{};
+  // Indirect draws of the chunks in the arena
+  ChunkDrawList chunkDrawList{};
+  // Culls and compacts the chunk draws on the gpu when supported
+  GpuChunkCuller gpuChunkCuller{};
+  // Last frames depth for occlusion culling
+  DepthPyramid depthPyramid{};
+  // Cpu occlusion culling through the chunk visibility
+  CaveCuller caveCuller{};
+  // Gpu resources released while frames in flight might still use them
+  DeletionQueue deletionQueue{};
+  // Timestamps around the passes of a frame
+  GpuProfiler gpuProfiler{};
+
   // Uniform Buffer Objects
   std::vector<Buffers::VmaBuffer> uniformBuffers;
   std::vector<void*> uniformBuffersMapped;
@@ -5,6 +5,9 @@
 
 struct Material {
    uint32_t id{0};
+
+   bool operator==(const Material &other) const { return id == other.id; }
+   bool operator!=(const Material &other) const { return id != other.id; }
 };
 
 namespace Materials {
@@ -1,28 +1,48 @@
 #include "Chunk.hpp"
-#include <functional>
-#include <Engine.h>
+#include "ChunkMesher.hpp"
 
-#include "Block/CubeDefinition.hpp"
+#include <algorithm>
+#include <array>
+#include <xmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static_assert((CHUNK_VOLUME) % 64 == 0, "Noise threshold kernel works on whole 64 voxel words");
 
 glm::ivec3 Chunk::getPos() {
   return pos;
 }
 
-Material *Chunk::getBlockUnsafe(int x, int y, int z) {
-  int index = x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE);
-  if (index < 0 || index > CHUNK_VOLUME) return nullptr;
-  return &blocks[index];
+/**
+ *  @brief Returns the block at the given local position without any bounds checking.
+ **/
+Material Chunk::getBlockUnsafe(int x, int y, int z) const {
+  return blocks.get(x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE));
+}
+
+/**
+ *  @brief Returns the block at the given local position, positions outside of this chunk are treated as air.
+ **/
+Material Chunk::getBlock(int x, int y, int z) const {
+  if (x < 0 || y < 0 || z < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE) return Materials::AIR;
+  return getBlockUnsafe(x, y, z);
 }
 
-Material &Chunk::getBlock(int xSafe, int ySafe, int zSafe) {
-  int index = xSafe + (ySafe * CHUNK_SIZE) + (zSafe * CHUNK_SIZE * CHUNK_SIZE);
-  return blocks.at(index);
+void Chunk::setBlock(int x, int y, int z, Material material) {
+  if (x < 0 || y < 0 || z < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE) return;
+  blocks.set(x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE), material);
+  bModified = true;
 }
 
 ChunkMesh &Chunk::getChunkMesh() {
   return chunkMesh;
 }
 
+const ChunkVisibility &Chunk::getVisibility() const {
+  return visibility;
+}
+
 bool Chunk::isChunkEmpty() const {
   return bEmpty;
 }
@@ -31,6 +51,10 @@ bool Chunk::isGenerated() const {
   return bGenerated;
 }
 
+bool Chunk::isUniformSolid() const {
+  return blocks.isUniform() && blocks.getPalette()[0] != Materials::AIR;
+}
+
 bool Chunk::isLoaded() const {
   return bLoaded;
 }
@@ -43,179 +67,163 @@ void Chunk::setChunkGenerated(bool generated) {
   bGenerated = generated;
 }
 
+bool Chunk::isUploadPending() const {
+  return bUploadPending;
+}
+
+void Chunk::setUploadPending(bool pending) {
+  bUploadPending = pending;
+}
+
+bool Chunk::isModified() const {
+  return bModified;
+}
+
+void Chunk::setModified(bool modified) {
+  bModified = modified;
+}
+
+void Chunk::pin() const {
+  pins.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Chunk::unpin() const {
+  pins.fetch_sub(1, std::memory_order_release);
+}
+
+bool Chunk::isPinned() const {
+  return pins.load(std::memory_order_acquire) > 0;
+}
+
+size_t Chunk::getMemoryUsage() const {
+  return sizeof(Chunk) + blocks.getMemoryUsage() + chunkMesh.vertices.capacity() * sizeof(BlockVertex) +
+         chunkMesh.indices.capacity() * sizeof(uint32_t);
+}
+
 // >---- GENERATION -----<
 
-bool solid(Material* mat) {
-  if(mat == nullptr) return false;
-  return mat->id > 0;
+static inline uint32_t popCount(uint64_t v) {
+#if defined(_MSC_VER)
+  return static_cast<uint32_t>(__popcnt64(v));
+#else
+  return static_cast<uint32_t>(__builtin_popcountll(v));
+#endif
+}
+
+/**
+ *  @brief Compares four densities per SSE instruction and packs the results into one bit per voxel, in the layout of a
+ *  1 bit VoxelStorage. Returns the number of solid voxels.
+ **/
+static uint32_t thresholdNoise(const float *noise, uint64_t *outMask) {
+  const __m128 threshold = _mm_set1_ps(SOLID_DENSITY);
+  uint32_t solidCount = 0;
+
+  for (uint32_t word = 0; word < CHUNK_VOLUME / 64; ++word) {
+    const float *densities = noise + word * 64;
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 64; i += 4) {
+      const int lanes = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(densities + i), threshold));
+      bits |= static_cast<uint64_t>(lanes) << i;
+    }
+    outMask[word] = bits;
+    solidCount += popCount(bits);
+  }
+  return solidCount;
 }
 
-bool Chunk::generate(std::vector<float> &noise) {
+/**
+ *  @brief Turns CHUNK_VOLUME densities in voxel order into air and solid voxels.
+ *  Returns false and leaves the chunk empty if there isn't a single solid voxel.
+ **/
+bool Chunk::generate(const float *noise) {
+  thread_local std::array<uint64_t, CHUNK_VOLUME / 64> mask{};
+  const uint32_t solidCount = thresholdNoise(noise, mask.data());
 
   // If we didn't find a single solid block just abort generating this chunk.
-  auto hasSolid = [](float val) { return val <= 0.5f; };
-  if (std::find_if(noise.begin(), noise.end(), hasSolid) == noise.end()) {
-    return false;
+  if (solidCount == 0) return false;
+
+  bEmpty = false;
+
+  // Fully solid chunks stay at zero bits per voxel
+  if (solidCount == CHUNK_VOLUME) {
+    blocks.fill(Materials::SOLID);
+  } else {
+    blocks.assignMask(mask.data(), Materials::AIR, Materials::SOLID);
   }
 
-  int index{};
+  bGenerated = true;
+  return true;
+}
+
+/**
+ *  @brief Fills the whole chunk with material without evaluating any noise, air leaves the chunk empty.
+ **/
+bool Chunk::generateUniform(Material material) {
+  if (material == Materials::AIR) return false;
 
   bEmpty = false;
+  blocks.fill(material);
+  bGenerated = true;
+  return true;
+}
 
-  // Iterate over noise and set blocks
-  for (int z = 0; z < CHUNK_SIZE; z++) {
-    for (int y = 0; y < CHUNK_SIZE; y++) {
-      for (int x = 0; x < CHUNK_SIZE; x++) {
-        blocks.push_back(Materials::SOLID);
-      }
-    }
-  }
+/**
+ *  @brief Takes over voxels that were decoded from a region file into getBlocks() instead of generating them.
+ *  Returns false if the chunk is all air, like generate does.
+ **/
+bool Chunk::applyLoadedVoxels() {
+  bModified = false;
+  if (blocks.isUniform() && blocks.getPalette()[0] == Materials::AIR) return false;
 
+  bEmpty = false;
   bGenerated = true;
   return true;
 }
 
-void Chunk::regenerateMesh() {
+/**
+ *  @brief Rebuilds the vertex and index data of this chunk with the mesher selected in ChunkMesher.
+ *  Border faces are culled against the given neighbours.
+ **/
+void Chunk::regenerateMesh(const ChunkNeighbours &neighbours) {
   if (bEmpty) return;
 
-  int vertIndex{0};
-  int indicesCount{0};
-
-  chunkMesh.vertices.reserve(CHUNK_VOLUME);
-  chunkMesh.indices.reserve(CHUNK_VOLUME);
-
-  static int texture = 0;
-  static int lightLevel = 1;
-
-  static ChunkHandler &ch = EngineData::i()->chunkHandler;
-
-  // We could reverse this, so we iterate only through empty blocks and set faces for solid blocks instead
-
-  for (int z = 0; z < CHUNK_SIZE; ++z) {
-    for (int y = 0; y < CHUNK_SIZE; ++y) {
-      for (int x = 0; x < CHUNK_SIZE; ++x) {
-        Material *block = getBlockUnsafe(x, y, z);
-        if (!solid(block)) continue;
-
-        glm::ivec3 vpos{x, y, z};
-
-        Material *blockFront = getBlockUnsafe(x, y, z + 1);
-        Material *blockBack = getBlockUnsafe(x, y, z - 1);
-        Material *blockRight = getBlockUnsafe(x + 1, y, z);
-        Material *blockLeft = getBlockUnsafe(x - 1, y, z);
-        Material *blockTop = getBlockUnsafe(x, y + 1, z);
-        Material *blockBot = getBlockUnsafe(x, y - 1, z);
-
-        // Top face
-        if (y == CHUNK_SIZE - 1 || blockTop->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = topFace[vertIndex++] + vpos.x;
-            unsigned int vertY = topFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = topFace[vertIndex++] + vpos.z;
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-        // Bot face
-        if (y == 0 || blockBot->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = botFace[vertIndex++] + vpos.x;
-            unsigned int vertY = botFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = botFace[vertIndex++] + vpos.z;
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-        // Front face
-        if (z == CHUNK_SIZE -1 || blockFront->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = frontFace[vertIndex++] + vpos.x;
-            unsigned int vertY = frontFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = frontFace[vertIndex++] + vpos.z;
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-        // Back face
-        if (z == 0 || blockBack->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = backFace[vertIndex++] + vpos.x;
-            unsigned int vertY = backFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = backFace[vertIndex++] + vpos.z;
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-        // Right face
-        if (x == CHUNK_SIZE - 1 || blockRight->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = rightFace[vertIndex++] + vpos.x;
-            unsigned int vertY = rightFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = rightFace[vertIndex++] + vpos.z;
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-        // Left face
-        if (x == 0 || blockLeft->id == 0) {
-          for (int i = 0; i < 4; i++) {
-            unsigned int vertX = leftFace[vertIndex++] + vpos.x;
-            unsigned int vertY = leftFace[vertIndex++] + vpos.y;
-            unsigned int vertZ = leftFace[vertIndex++] + vpos.z;
-
-            unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
-            chunkMesh.vertices.emplace_back(BlockVertex{vert});
-          }
-          for (uint8_t i: faceIndices) {
-            chunkMesh.indices.push_back(i + indicesCount);
-          }
-          indicesCount += 4;
-          vertIndex = 0;
-        }
-
-      }
-    }
-  }
+  // Also needed if no face ends up meshed, fully solid chunks are what hides the chunks behind them
+  visibility = ChunkVisibility::compute(*this);
 
-  if (indicesCount == 0) {
-    bEmpty = true;
+  // Buried between solid chunks, not a single face could be visible
+  auto isBuried = [](const Chunk *neighbour) { return neighbour != nullptr && neighbour->isUniformSolid(); };
+  if (isUniformSolid() && std::all_of(neighbours.chunks.begin(), neighbours.chunks.end(), isBuried)) {
+    chunkMesh.vertices.clear();
+    chunkMesh.indices.clear();
+    bHasMesh = false;
+    bMeshed = true;
     return;
   }
+
+  ChunkMesher::mesh(*this, neighbours, chunkMesh);
+
+  bHasMesh = !chunkMesh.indices.empty();
   bMeshed = true;
+  if (!bHasMesh) return;
+
+  // Tight bounds of the geometry in rendered space, the shader reads x from bits 12-17 and z from bits 0-5
+  glm::uvec3 min{CHUNK_SIZE};
+  glm::uvec3 max{0};
+  for (const BlockVertex &vertex: chunkMesh.vertices) {
+    glm::uvec3 p{(vertex.packedVert >> 12) & 0x3Fu, (vertex.packedVert >> 6) & 0x3Fu, vertex.packedVert & 0x3Fu};
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  glm::vec3 center = glm::vec3(min + max) * 0.5f;
+  glm::vec3 halfWidth = glm::vec3(max - min) * 0.5f;
+  chunkMesh.boundingBox = AABB{Point{center.x, center.y, center.z}, Point{halfWidth.x, halfWidth.y, halfWidth.z}};
+}
+
+VoxelStorage &Chunk::getBlocks() {
+  return this->blocks;
 }
 
-std::deque<Material> &Chunk::getBlocks() {
+const VoxelStorage &Chunk::getBlocks() const {
   return this->blocks;
 }
 
@@ -223,6 +231,10 @@ bool Chunk::isMeshed() const {
   return this->bMeshed;
 }
 
+bool Chunk::hasMesh() const {
+  return this->bHasMesh;
+}
+
 bool Chunk::generateNoise(const std::vector<float> &noise) {
   return false;
 }
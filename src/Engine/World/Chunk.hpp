@@ -1,60 +1,104 @@
 #pragma once
 
 #include "VulkanPipeline/Pipeline/Buffer/Buffer.h"
-#include <deque>
 
 #include "Block.hpp"
+#include "VoxelStorage.hpp"
+#include "ChunkVisibility.hpp"
 #include "FastNoise/SmartNode.h"
 #include "Renderer/Mesh/Mesh.h"
 
+#include <atomic>
+
 #define CSM 62
 inline const int CHUNK_SIZE = 48;
 #define CHUNK_SIZE_2 CHUNK_SIZE * CHUNK_SIZE
 #define CHUNK_VOLUME CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE
 
+// Noise at or below this density is solid
+inline const float SOLID_DENSITY = 0.5f;
+
+struct ChunkNeighbours;
+
 //TODO: Dont save this
 struct ChunkMesh {
   std::vector<BlockVertex> vertices{};
   std::vector<uint32_t> indices{};
   Mesh mesh{};
-  AABB boundingBox{Point{0, 0, 0}, Point{CHUNK_SIZE/2, CHUNK_SIZE/2, CHUNK_SIZE/2}};
+  // Chunk local, tight around the meshed geometry
+  AABB boundingBox{Point{CHUNK_SIZE/2, CHUNK_SIZE/2, CHUNK_SIZE/2}, Point{CHUNK_SIZE/2, CHUNK_SIZE/2, CHUNK_SIZE/2}};
 };
 
 class Chunk {
 public:
   explicit Chunk(const glm::ivec3& pos) : pos(pos) {}
 
+  // Only air, such a chunk is never meshed
   [[nodiscard]] bool isChunkEmpty() const;
   [[nodiscard]] bool isLoaded() const;
   [[nodiscard]] bool isGenerated() const;
   [[nodiscard]] bool isMeshed() const;
+  // The last mesh has triangles, buried chunks and ones whose faces are all culled have nothing to draw
+  [[nodiscard]] bool hasMesh() const;
+  // A single non air material and no per voxel storage
+  [[nodiscard]] bool isUniformSolid() const;
 
   void setChunkLoaded(bool loaded);
   void setChunkGenerated(bool generated);
 
+  // Set while the mesh is on its way to the gpu, such a chunk must not be unloaded
+  [[nodiscard]] bool isUploadPending() const;
+  void setUploadPending(bool pending);
+
+  // Voxels were edited after generating, they have to be written to the region file before unloading
+  [[nodiscard]] bool isModified() const;
+  void setModified(bool modified);
+
+  // Jobs reading the voxels of this chunk, it is only deleted once nobody holds a pin
+  void pin() const;
+  void unpin() const;
+  [[nodiscard]] bool isPinned() const;
+
+  // Voxel and cpu side mesh data in bytes
+  [[nodiscard]] size_t getMemoryUsage() const;
+
   [[nodiscard]] glm::ivec3 getPos();
 
-  Material* getBlockUnsafe(int x, int y, int z);
-  Material& getBlock(int xSafe, int ySafe, int zSafe);
+  Material getBlockUnsafe(int x, int y, int z) const;
+  Material getBlock(int x, int y, int z) const;
+  void setBlock(int x, int y, int z, Material material);
 
-  std::deque<Material>& getBlocks();
+  VoxelStorage& getBlocks();
+  [[nodiscard]] const VoxelStorage& getBlocks() const;
 
   ChunkMesh& getChunkMesh();
 
-  bool generate(std::vector<float>& noise);
+  [[nodiscard]] const ChunkVisibility& getVisibility() const;
+
+  bool generate(const float* noise);
+  bool generateUniform(Material material);
   bool generateNoise(const std::vector<float>& noise);
-  void regenerateMesh();
+  bool applyLoadedVoxels();
+  void regenerateMesh(const ChunkNeighbours& neighbours);
 
 private:
   glm::ivec3 pos{}; // Chunk pos normalized
 
-  std::deque<Material> blocks{};
+  VoxelStorage blocks{CHUNK_VOLUME};
 
   ChunkMesh chunkMesh{};
 
+  // Empty chunks never get meshed and stay fully see-through
+  ChunkVisibility visibility = ChunkVisibility::open();
+
   bool bGenerated = false;
   bool bHasAllNeighbours = false;
   bool bMeshed = false;
+  bool bHasMesh = false;
   bool bEmpty = true;
   bool bLoaded = false;
+  bool bUploadPending = false;
+  bool bModified = false;
+
+  mutable std::atomic<int> pins{0};
 };
@@ -0,0 +1,136 @@
+#include "ChunkEvictor.hpp"
+
+#include "ChunkHandler.hpp"
+#include "RegionStorage.hpp"
+#include <Logging/Logger.h>
+
+#include <algorithm>
+#include <cmath>
+
+ChunkEvictor::ChunkEvictor(ChunkHandler &chunkHandler, RegionStorage *regionStorage, MeshVramFn meshVram,
+                           ReleaseMeshFn releaseMesh)
+    : chunkHandler(chunkHandler), regionStorage(regionStorage), meshVram(std::move(meshVram)),
+      releaseMesh(std::move(releaseMesh)) {}
+
+void ChunkEvictor::setBudgets(size_t ramBytes, size_t vramBytes) {
+  ramBudget = ramBytes;
+  vramBudget = vramBytes;
+  warnedBudget = false;
+}
+
+void ChunkEvictor::setHysteresis(float chunks) {
+  hysteresis = chunks;
+}
+
+/**
+ *  @brief Unloads every chunk outside of the render distance plus hysteresis, then the least recently used chunks
+ *  outside of the render distance until both budgets are met. rangeSq and rangeY are the render distance the chunks
+ *  get generated in. Has to run on the main thread after the uploads were handed out.
+ **/
+void ChunkEvictor::update(const glm::vec3 &camChunkPos, float rangeSq, int rangeY) {
+  tick++;
+
+  const float keepRange = std::sqrt(rangeSq) + hysteresis;
+  const float keepRangeSq = keepRange * keepRange;
+  const int keepRangeY = rangeY + static_cast<int>(std::ceil(hysteresis));
+  const int camChunkY = static_cast<int>(std::floor(camChunkPos.y));
+
+  auto distanceSq = [&](const glm::ivec3 &pos) {
+    const glm::vec3 offset = glm::vec3(pos) + 0.5f - camChunkPos;
+    return glm::dot(offset, offset);
+  };
+  // Same vertical range as the scan in Voxelate::update
+  auto isInRangeY = [&](const glm::ivec3 &pos, int range) {
+    return pos.y >= camChunkY - range && pos.y < camChunkY + range;
+  };
+  auto isKept = [&](const glm::ivec3 &pos) {
+    return distanceSq(pos) <= keepRangeSq && isInRangeY(pos, keepRangeY);
+  };
+
+  struct Candidate {
+    Chunk *chunk;
+    uint64_t lastUsed;
+    float distanceSq;
+    size_t ram;
+    size_t vram;
+  };
+  std::vector<Candidate> candidates;
+
+  ramUsage = 0;
+  vramUsage = 0;
+  for (Chunk *chunk: chunkHandler.getChunksGenerated()) {
+    const glm::ivec3 pos = chunk->getPos();
+
+    const size_t ram = chunk->getMemoryUsage();
+    const size_t vram = meshVram(chunk->getChunkMesh().mesh);
+
+    // Chunks the scan in Voxelate::update would generate count as used
+    const float distSq = distanceSq(pos);
+    if (distSq <= rangeSq && isInRangeY(pos, rangeY)) {
+      lastUsed[pos] = tick;
+    }
+
+    // Its upload callback still refers to it
+    if (chunk->isUploadPending()) {
+      ramUsage += ram;
+      vramUsage += vram;
+      continue;
+    }
+
+    if (!isKept(pos)) {
+      evict(chunk);
+      continue;
+    }
+
+    ramUsage += ram;
+    vramUsage += vram;
+    // Chunks that were never inside the render distance count as the oldest
+    auto used = lastUsed.find(pos);
+    const uint64_t usedTick = used != lastUsed.end() ? used->second : 0;
+    if (usedTick != tick) {
+      candidates.push_back({chunk, usedTick, distSq, ram, vram});
+    }
+  }
+
+  if (ramUsage > ramBudget || vramUsage > vramBudget) {
+    // Oldest first, the farthest of equally old chunks first
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+      if (a.lastUsed != b.lastUsed) return a.lastUsed < b.lastUsed;
+      return a.distanceSq > b.distanceSq;
+    });
+
+    for (const Candidate &candidate: candidates) {
+      if (ramUsage <= ramBudget && vramUsage <= vramBudget) break;
+      ramUsage -= candidate.ram;
+      vramUsage -= candidate.vram;
+      evict(candidate.chunk);
+    }
+
+    // Evicting chunks inside the render distance would only regenerate them right away
+    if ((ramUsage > ramBudget || vramUsage > vramBudget) && !warnedBudget) {
+      LOG(W, "Chunk memory budget is smaller than the render distance needs");
+      warnedBudget = true;
+    }
+  }
+
+  chunkHandler.unloadNoiseChunks([&](const glm::ivec3 &pos) { return !isKept(pos); });
+  chunkHandler.deleteUnloadedChunks();
+}
+
+/**
+ *  @brief Removes the chunk from the world and hands its mesh to the renderer to be released.
+ **/
+void ChunkEvictor::evict(Chunk *chunk) {
+  const glm::ivec3 pos = chunk->getPos();
+
+  Mesh mesh = chunk->getChunkMesh().mesh;
+  if (!chunkHandler.unloadChunk(pos)) return;
+
+  // Generated voxels are saved right away, only edits would get lost
+  if (chunk->isModified() && regionStorage != nullptr) regionStorage->save(chunk);
+
+  releaseMesh(pos, mesh);
+
+  lastUsed.erase(pos);
+  evictedChunks++;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "ChunkMap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+class Chunk;
+class ChunkHandler;
+class Mesh;
+class RegionStorage;
+
+/**
+ *  @brief Unloads chunks that left the render distance plus some hysteresis and keeps the voxel data in RAM and the
+ *  chunk meshes in VRAM under a budget. Over budget the least recently used chunks outside the render distance go
+ *  first. The meshes are left to the renderer through the callbacks, nothing in here needs a Vulkan device.
+ **/
+class ChunkEvictor {
+public:
+  // Bytes the mesh takes in VRAM, 0 if it was never uploaded
+  using MeshVramFn = std::function<size_t(const Mesh &)>;
+  // Called with the mesh of a chunk that was just unloaded, it has to outlive the frames still using it
+  using ReleaseMeshFn = std::function<void(const glm::ivec3 &, const Mesh &)>;
+
+  // Without a regionStorage edited chunks are dropped like generated ones
+  ChunkEvictor(ChunkHandler &chunkHandler, RegionStorage *regionStorage, MeshVramFn meshVram,
+               ReleaseMeshFn releaseMesh);
+
+  void setBudgets(size_t ramBytes, size_t vramBytes);
+  // Extra chunks beyond the render distance a chunk survives, so moving back and forth doesn't regenerate it
+  void setHysteresis(float chunks);
+
+  void update(const glm::vec3 &camChunkPos, float rangeSq, int rangeY);
+
+  [[nodiscard]] size_t getRamUsage() const { return ramUsage; }
+  [[nodiscard]] size_t getVramUsage() const { return vramUsage; }
+  [[nodiscard]] size_t getRamBudget() const { return ramBudget; }
+  [[nodiscard]] size_t getVramBudget() const { return vramBudget; }
+  [[nodiscard]] uint64_t getEvictedChunks() const { return evictedChunks; }
+
+private:
+  void evict(Chunk *chunk);
+
+  ChunkHandler &chunkHandler;
+  RegionStorage *regionStorage;
+  MeshVramFn meshVram;
+  ReleaseMeshFn releaseMesh;
+
+  // Last update the chunk was inside the render distance
+  std::unordered_map<glm::ivec3, uint64_t, ChunkPosHash> lastUsed;
+  uint64_t tick{0};
+
+  size_t ramBudget{1024ull * 1024 * 1024};
+  size_t vramBudget{512ull * 1024 * 1024};
+  float hysteresis{2.0f};
+
+  size_t ramUsage{0};
+  size_t vramUsage{0};
+  uint64_t evictedChunks{0};
+
+  bool warnedBudget{false};
+};
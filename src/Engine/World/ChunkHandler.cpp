@@ -1,93 +1,456 @@
 #include "ChunkHandler.hpp"
-#include "Engine.h"
+#include "RegionStorage.hpp"
 #include "Util/Util.hpp"
+#include "VoxelAccess.hpp"
+#include "TerrainNoise.hpp"
 
-#include <FastNoise/FastNoise.h>
+#include <Logging/Logger.h>
+#include <Logging/Profiler.hpp>
 
-const FastNoise::SmartNode<> fnGenerator = FastNoise::NewFromEncodedNodeTree(
-  "IgAAAIA/CtejPBkAIQAEAAAAAACamRlAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACQAACtcjPQEZAAQAAAAAAGZm5j8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABDQACAAAAAAAAQAcAAGZmZr8AAACAQA==");
+#include <algorithm>
+#include <chrono>
 
+// Every n-th uniform chunk gets its full noise evaluated anyway to catch a margin that is too small
+static constexpr uint64_t COARSE_CHECK_INTERVAL = 64;
 
+ChunkHandler::ChunkHandler(JobSystem &jobSystem, RegionStorage *regionStorage)
+    : jobSystem(jobSystem), regionStorage(regionStorage) {}
+
+/**
+ *  @brief Deletes every chunk still owned by the handler. No job of it may run anymore, stop the JobSystem or call
+ *  waitIdle first.
+ **/
+ChunkHandler::~ChunkHandler() {
+  for (Chunk *chunk: chunksGenerated) delete chunk;
+  ghostChunks.forEach([](const glm::ivec3 &, Chunk *chunk) { delete chunk; });
+  for (Chunk *chunk: chunkUnloadList) delete chunk;
+}
+
+/**
+ *  @brief Blocks until every job this handler scheduled has run. Jobs the JobSystem dropped while stopping never
+ *  finish, so this must not be called after stopping it.
+ **/
+void ChunkHandler::waitIdle() {
+  while (activeJobs.load(std::memory_order_acquire) != 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+/**
+ *  @brief Schedules the job on the JobSystem and keeps track of it for waitIdle.
+ **/
+JobHandle ChunkHandler::scheduleJob(std::function<void()> job, const std::vector<JobHandle> &dependencies) {
+  activeJobs.fetch_add(1, std::memory_order_relaxed);
+  return jobSystem.schedule([this, job = std::move(job)] {
+    job();
+    activeJobs.fetch_sub(1, std::memory_order_release);
+  }, dependencies);
+}
+
+/**
+ *  @brief True if the chunk is queued or currently being generated.
+ **/
 bool ChunkHandler::isChunkInQueue(const glm::ivec3& pos) {
-  return std::find(chunkGenList.begin(), chunkGenList.end(), pos) != chunkGenList.end();
+  std::lock_guard<std::mutex> lock(queueMutex);
+  return chunksQueued.find(pos) != chunksQueued.end();
+}
+
+/**
+ *  @brief Orders the queue by distance to chunkSpacePos and the angle to viewDir.
+ *  Queued chunks further away than rangeSq are cancelled. Cheap to call every frame, the queue is only rebuilt
+ *  once the camera moved or turned noticeably, returns true if it was.
+ **/
+bool ChunkHandler::setFocus(const glm::vec3 &chunkSpacePos, const glm::vec3 &viewDir, float rangeSq) {
+  const glm::vec3 dir = glm::normalize(viewDir);
+
+  std::lock_guard<std::mutex> lock(queueMutex);
+  const glm::vec3 moved = chunkSpacePos - focusPos;
+  if (glm::dot(moved, moved) < 0.25f && glm::dot(dir, focusDir) > 0.95f && rangeSq == focusRangeSq) return false;
+
+  focusPos = chunkSpacePos;
+  focusDir = dir;
+  focusRangeSq = rangeSq;
+
+  // Cancel what is out of range now and re-prioritize the rest
+  size_t kept = 0;
+  for (QueuedChunk &queued: chunkGenQueue) {
+    // Taken into a batch already
+    if (chunksInQueue.find(queued.pos) == chunksInQueue.end()) continue;
+
+    const glm::vec3 offset = glm::vec3(queued.pos) + 0.5f - focusPos;
+    if (glm::dot(offset, offset) > focusRangeSq) {
+      chunksQueued.erase(queued.pos);
+      chunksInQueue.erase(queued.pos);
+      continue;
+    }
+    queued.priority = getPriority(queued.pos);
+    chunkGenQueue[kept++] = queued;
+  }
+  chunkGenQueue.resize(kept);
+
+  std::make_heap(chunkGenQueue.begin(), chunkGenQueue.end());
+  return true;
+}
+
+/**
+ *  @brief Squared distance to the focus, chunks behind the camera count up to three times as far.
+ *  queueMutex has to be held.
+ **/
+float ChunkHandler::getPriority(const glm::ivec3 &pos) const {
+  const glm::vec3 offset = glm::vec3(pos) + 0.5f - focusPos;
+  const float distanceSq = glm::dot(offset, offset);
+  if (distanceSq < 1.0f) return distanceSq;
+
+  const float cosAngle = glm::dot(offset, focusDir) / std::sqrt(distanceSq);
+  return distanceSq * (2.0f - cosAngle);
 }
 
 /**
- *  @brief Adds a chunk to the chunkGenList and signals a thread for generating.
+ *  @brief Adds a chunk to the chunkGenQueue and schedules a job for generating.
+ *  The job takes whatever positions have the highest priority at that time, not necessarily this one.
  **/
 void ChunkHandler::addChunkToQueue(const glm::ivec3 &pos) {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (!chunksQueued.insert(pos).second) return;
+    chunksInQueue.insert(pos);
+    chunkGenQueue.push_back({pos, getPriority(pos)});
+    std::push_heap(chunkGenQueue.begin(), chunkGenQueue.end());
+  }
+
+  scheduleJob([this] {
+    std::vector<glm::ivec3> batch;
+    if (popChunkBatch(batch)) generateChunks(batch);
+  });
+}
+
+/**
+ *  @brief Takes the position with the highest priority out of the chunkGenQueue together with up to NOISE_BATCH - 1
+ *  queued neighbours in a row along x, sorted by x. Returns false if there is nothing to generate.
+ *  The positions stay marked as queued until meshChunk has published the chunks.
+ **/
+bool ChunkHandler::popChunkBatch(std::vector<glm::ivec3> &outPositions) {
+  std::lock_guard<std::mutex> lock(queueMutex);
+  outPositions.clear();
+
+  while (!chunkGenQueue.empty() && outPositions.empty()) {
+    std::pop_heap(chunkGenQueue.begin(), chunkGenQueue.end());
+    const glm::ivec3 pos = chunkGenQueue.back().pos;
+    chunkGenQueue.pop_back();
+    if (chunksInQueue.erase(pos) != 0) outPositions.push_back(pos);
+  }
+  if (outPositions.empty()) return false;
+
+  const glm::ivec3 first = outPositions[0];
+  for (int dir: {1, -1}) {
+    for (int step = 1; outPositions.size() < NOISE_BATCH; ++step) {
+      const glm::ivec3 next = first + glm::ivec3(dir * step, 0, 0);
+      if (chunksInQueue.erase(next) == 0) break;
+      outPositions.push_back(next);
+    }
+  }
+
+  std::sort(outPositions.begin(), outPositions.end(), [](const glm::ivec3 &a, const glm::ivec3 &b) {
+    return a.x < b.x;
+  });
+  return true;
+}
+
+/**
+ *  @brief Fills the chunks voxels from their region file, chunks that were never saved are generated from the terrain
+ *  noise and saved. Chunks next to each other along x get their noise in one go.
+ **/
+void ChunkHandler::generateVoxels(const std::vector<Chunk *> &chunks) {
+  PROFILE_ZONE("generateVoxels");
+  std::vector<Chunk *> generated;
+  // Only chunks the coarse pass couldn't classify get their full noise evaluated
+  std::vector<Chunk *> mixed;
+  std::vector<std::pair<Chunk *, TerrainNoise::NoiseClass>> spotChecks;
+  for (Chunk *chunk: chunks) {
+    if (regionStorage != nullptr && regionStorage->load(chunk)) continue;
+    generated.push_back(chunk);
+
+    const TerrainNoise::NoiseClass noiseClass = TerrainNoise::classify(chunk->getPos());
+    if (noiseClass == TerrainNoise::NoiseClass::MIXED) {
+      mixed.push_back(chunk);
+    } else if (uniformChunks.fetch_add(1, std::memory_order_relaxed) % COARSE_CHECK_INTERVAL == 0) {
+      mixed.push_back(chunk);
+      spotChecks.emplace_back(chunk, noiseClass);
+    } else {
+      chunk->generateUniform(noiseClass == TerrainNoise::NoiseClass::SOLID ? Materials::SOLID : Materials::AIR);
+    }
+  }
+
+  size_t begin = 0;
+  while (begin < mixed.size()) {
+    size_t end = begin + 1;
+    while (end < mixed.size() && mixed[end]->getPos() == mixed[end - 1]->getPos() + glm::ivec3(1, 0, 0)) end++;
+    generateNoise(mixed.data() + begin, end - begin);
+    begin = end;
+  }
+
+  for (const auto &[chunk, noiseClass]: spotChecks) {
+    const bool solid = noiseClass == TerrainNoise::NoiseClass::SOLID;
+    const bool matches = solid ? chunk->isUniformSolid() : chunk->isChunkEmpty();
+    if (matches) continue;
+    coarseMisses.fetch_add(1, std::memory_order_relaxed);
+    LOG_FIRST(W, 1, "Coarse noise classified a mixed chunk as uniform, COARSE_MARGIN is too small");
+  }
 
-  chunkGenList.push_front(pos);
-  EngineData::i()->threadPool.signalBuilderThreads();
+  if (regionStorage == nullptr) return;
+  for (Chunk *chunk: generated) regionStorage->save(chunk);
+}
+
+/**
+ *  @brief Evaluates the terrain noise of count chunks in a row along x with a single grid and generates them.
+ *  The grid buffer is kept per thread.
+ **/
+void ChunkHandler::generateNoise(Chunk *const *chunks, size_t count) {
+  PROFILE_ZONE("generateNoise");
+  thread_local std::vector<float> noise;
+  noise.resize(count * CHUNK_VOLUME);
+
+  TerrainNoise::evaluate(chunks[0]->getPos(), count, noise.data());
+
+  for (size_t i = 0; i < count; ++i) {
+    chunks[i]->generate(noise.data() + i * CHUNK_VOLUME);
+  }
 }
 
 /**
  *  @brief IMPORTANT: This should never be called. Use addChunkToQueue instead, otherwise it will crash the engine.
- *  This will generate noise for surrounding chunks first and then completely generate the main chunk.
+ *  Splits the chunks into one noise job for all of them and a meshing job per chunk that runs once the noise is done.
  */
-void ChunkHandler::generateChunk(const glm::ivec3 &pos) {
-  Chunk* chunk = this->getChunk(pos);
-
-  // If this chunk is not existing
-  if(chunk == nullptr) {
+void ChunkHandler::generateChunks(const std::vector<glm::ivec3> &positions) {
+  PROFILE_ZONE("generateChunks");
+  std::vector<Chunk *> chunks;
+  std::vector<Chunk *> needVoxels;
+  for (const glm::ivec3 &pos: positions) {
+    // Chunk is already generated
+    if (this->getChunk(pos) != nullptr) {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      chunksQueued.erase(pos);
+      continue;
+    }
 
-    chunk = new Chunk{pos};
+    // Adopt the noise chunk if a neighbour already needed this one, its voxels are final
+    Chunk *chunk;
+    {
+      std::lock_guard<std::mutex> lock(ghostMutex);
+      chunk = ghostChunks.erase(pos);
+    }
+    if (chunk == nullptr) {
+      chunk = new Chunk{pos};
+      needVoxels.push_back(chunk);
+    }
+    chunks.push_back(chunk);
+  }
 
-    // Step 2: Check for neighbours and generate the missing ones
-    glm::ivec3 posTop = {pos.x, pos.y + 1, pos.z};
-    glm::ivec3 posBot = {pos.x, pos.y - 1, pos.z};
-    glm::ivec3 posLeft = {pos.x - 1, pos.y, pos.z};
-    glm::ivec3 posRight = {pos.x + 1, pos.y, pos.z};
-    glm::ivec3 posFront = {pos.x, pos.y, pos.z - 1};
-    glm::ivec3 posBack = {pos.x, pos.y, pos.z + 1};
+  JobHandle noiseJob{};
+  if (!needVoxels.empty()) {
+    noiseJob = scheduleJob([this, needVoxels] {
+      generateVoxels(needVoxels);
+    });
+  }
 
-    std::vector<float> noise(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
-    fnGenerator->GenUniformGrid3D(noise.data(),
-                                  chunk->getPos().z * CHUNK_SIZE,
-                                  chunk->getPos().y * CHUNK_SIZE,
-                                  chunk->getPos().x * CHUNK_SIZE,
-                                  CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 0.03f, 69);
+  for (Chunk *chunk: chunks) {
+    scheduleJob([this, chunk] {
+      meshChunk(chunk);
+    }, {noiseJob});
+  }
+}
 
-    chunk->generate(noise);
+/**
+ *  @brief Meshes the chunk against its six neighbours and publishes it, missing neighbours are created as noise chunks.
+ **/
+void ChunkHandler::meshChunk(Chunk *chunk) {
+  PROFILE_ZONE("meshChunk");
+  const glm::ivec3 pos = chunk->getPos();
 
-    chunksGenerated.push_back(chunk);
-    chunk->regenerateMesh();
+  // Border faces are culled against the neighbours voxel data
+  ChunkNeighbours neighbours{};
+  if (!chunk->isChunkEmpty()) {
+    // Evaluate the noise of missing neighbours in parallel, waiting works on other jobs in the meantime
+    std::array<JobHandle, 6> noiseJobs{};
+    for (int dir = 0; dir < 6; ++dir) {
+      const glm::ivec3 neighbourPos = pos + directionOffsets[dir];
+      if (hasChunkOrNoiseChunk(neighbourPos)) continue;
+      // Only creates it, the pin is taken by acquireChunkOrNoiseChunk below
+      noiseJobs[dir] = scheduleJob([this, neighbourPos] {
+        releaseChunk(createNoiseChunk(neighbourPos));
+      });
+    }
 
+    for (int dir = 0; dir < 6; ++dir) {
+      jobSystem.wait(noiseJobs[dir]);
+      neighbours.chunks[dir] = acquireChunkOrNoiseChunk(pos + directionOffsets[dir]);
+    }
+  }
 
-    // Check and add to queue for generation
-//    if(!getChunk(posTop)) addChunkToQueue(posTop);
-//    if(!getChunk(posBot)) addChunkToQueue(posBot);
-//    if(!getChunk(posLeft)) addChunkToQueue(posLeft);
-//    if(!getChunk(posRight)) addChunkToQueue(posRight);
-//    if(!getChunk(posFront)) addChunkToQueue(posFront);
-//    if(!getChunk(posBack)) addChunkToQueue(posBack);
+  chunk->regenerateMesh(neighbours);
 
-  } else {
-    // Chunk is already generated we can look up neighbours and maybe mesh it
+  for (const Chunk *neighbour: neighbours.chunks) {
+    if (neighbour != nullptr) releaseChunk(neighbour);
+  }
 
+  // Publish the finished chunk, only now other threads can see it. The main thread picks it up for uploading.
+  {
+    std::lock_guard<std::mutex> lock(chunkMutex);
+    chunkMap.insert(pos, chunk);
+    chunksGenerated.push_back(chunk);
+    chunksToUpload.push_back(chunk);
+  }
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    chunksQueued.erase(pos);
+  }
+  {
+    // A noise chunk for this position might have been created while we were generating,
+    // other jobs could still be reading it so it only gets retired here.
+    std::lock_guard<std::mutex> lock(ghostMutex);
+    Chunk *ghost = ghostChunks.erase(pos);
+    if (ghost != nullptr) chunkUnloadList.push_back(ghost);
   }
 }
 
 /**
  * @brief Creates a noise chunk for only noise data.
- * This is meant to be executed on the same thread where the main chunk gets generated.
  * Needed so the main chunk can get surrounding noise data for meshing.
+ * The noise chunk is kept so generateChunks can adopt it later instead of evaluating the noise again.
+ * It is returned pinned like from acquireChunkOrNoiseChunk, hand it back with releaseChunk.
+ **/
+Chunk *ChunkHandler::createNoiseChunk(const glm::ivec3 &pos) {
+  auto *chunk = new Chunk{pos};
+  generateVoxels({chunk});
+
+  std::lock_guard<std::mutex> lock(ghostMutex);
+  // Another job was faster, use its noise chunk
+  if (Chunk *existing = ghostChunks.find(pos)) {
+    delete chunk;
+    existing->pin();
+    return existing;
+  }
+  ghostChunks.insert(pos, chunk);
+  chunk->pin();
+  return chunk;
+}
+
+/**
+ *  @brief True if there is a generated chunk or a noise chunk at pos.
  **/
-void ChunkHandler::createNoiseChunk(const glm::ivec3 &pos) {
+bool ChunkHandler::hasChunkOrNoiseChunk(const glm::ivec3 &pos) {
+  if (getChunk(pos) != nullptr) return true;
+  std::lock_guard<std::mutex> lock(ghostMutex);
+  return ghostChunks.find(pos) != nullptr;
+}
 
+/**
+ *  @brief Returns the generated chunk at pos or a noise chunk holding its voxels. The chunk is pinned so it can't be
+ *  deleted while it is read, hand it back with releaseChunk.
+ **/
+Chunk *ChunkHandler::acquireChunkOrNoiseChunk(const glm::ivec3 &pos) {
+  {
+    std::lock_guard<std::mutex> lock(chunkMutex);
+    if (Chunk *chunk = chunkMap.find(pos)) {
+      chunk->pin();
+      return chunk;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(ghostMutex);
+    if (Chunk *ghost = ghostChunks.find(pos)) {
+      ghost->pin();
+      return ghost;
+    }
+  }
+  return createNoiseChunk(pos);
+}
+
+void ChunkHandler::releaseChunk(const Chunk *chunk) {
+  chunk->unpin();
 }
 
 Chunk *ChunkHandler::getChunk(const glm::ivec3 &pos) {
-  const auto isSamePos = [pos](Chunk *chunk) { return pos == chunk->getPos(); };
-  auto it = std::find_if(chunksGenerated.begin(), chunksGenerated.end(), isSamePos);
-  if (it == chunksGenerated.end()) return nullptr;
-  return *it;
+  std::lock_guard<std::mutex> lock(chunkMutex);
+  return chunkMap.find(pos);
 }
 
-std::vector<Chunk *> &ChunkHandler::getChunksGenerated() {
+/**
+ *  @brief Snapshot of all chunks generated so far.
+ **/
+std::vector<Chunk *> ChunkHandler::getChunksGenerated() {
+  std::lock_guard<std::mutex> lock(chunkMutex);
   return this->chunksGenerated;
 }
 
-std::deque<glm::ivec3> *ChunkHandler::getChunkGenQueue() {
-  return &this->chunkGenList;
+/**
+ *  @brief Hands every chunk finished since the last call over to the caller (main thread) for uploading.
+ **/
+std::vector<Chunk *> ChunkHandler::takeChunksToUpload() {
+  std::lock_guard<std::mutex> lock(chunkMutex);
+  std::vector<Chunk *> chunks{};
+  chunks.swap(chunksToUpload);
+  return chunks;
+}
+
+/**
+ *  @brief Takes a generated chunk out of the world, it is deleted by deleteUnloadedChunks once no job reads it.
+ *  Its gpu resources are the callers business. Returns false if there was no chunk at pos.
+ **/
+bool ChunkHandler::unloadChunk(const glm::ivec3 &pos) {
+  Chunk *chunk;
+  {
+    std::lock_guard<std::mutex> lock(chunkMutex);
+    chunk = chunkMap.erase(pos);
+    if (chunk == nullptr) return false;
+
+    chunksGenerated.erase(std::find(chunksGenerated.begin(), chunksGenerated.end(), chunk));
+    auto toUpload = std::find(chunksToUpload.begin(), chunksToUpload.end(), chunk);
+    if (toUpload != chunksToUpload.end()) chunksToUpload.erase(toUpload);
+  }
+
+  std::lock_guard<std::mutex> lock(ghostMutex);
+  chunkUnloadList.push_back(chunk);
+  return true;
+}
+
+/**
+ *  @brief Retires every noise chunk shouldUnload returns true for, returns how many were retired.
+ **/
+size_t ChunkHandler::unloadNoiseChunks(const std::function<bool(const glm::ivec3 &)> &shouldUnload) {
+  std::lock_guard<std::mutex> lock(ghostMutex);
+
+  std::vector<glm::ivec3> positions;
+  ghostChunks.forEach([&](const glm::ivec3 &pos, Chunk *) {
+    if (shouldUnload(pos)) positions.push_back(pos);
+  });
+
+  for (const glm::ivec3 &pos: positions) {
+    chunkUnloadList.push_back(ghostChunks.erase(pos));
+  }
+  return positions.size();
+}
+
+size_t ChunkHandler::getUnloadedChunks() {
+  std::lock_guard<std::mutex> lock(ghostMutex);
+  return chunkUnloadList.size();
+}
+
+/**
+ *  @brief Deletes the unloaded chunks no job holds a pin on anymore, returns how many were deleted.
+ **/
+size_t ChunkHandler::deleteUnloadedChunks() {
+  std::lock_guard<std::mutex> lock(ghostMutex);
+
+  size_t deleted = 0;
+  for (auto it = chunkUnloadList.begin(); it != chunkUnloadList.end();) {
+    if ((*it)->isPinned()) {
+      ++it;
+      continue;
+    }
+    delete *it;
+    it = chunkUnloadList.erase(it);
+    deleted++;
+  }
+  return deleted;
 }
@@ -3,34 +3,120 @@
 #include <vector>
 #include <queue>
 #include <thread>
+#include <mutex>
+#include <unordered_set>
+#include <limits>
+#include <functional>
+#include <atomic>
 
 #include "Chunk.hpp"
+#include "ChunkMap.hpp"
 
+#include <Threading/JobSystem.hpp>
+
+class RegionStorage;
+
+/**
+ *  @brief One world of chunks. Generates and meshes chunks on the given JobSystem and persists them in the given
+ *  RegionStorage, nothing in here needs a window or a Vulkan device. Several ChunkHandlers can share a JobSystem,
+ *  each needs its own RegionStorage.
+ **/
 class ChunkHandler {
 public:
-  void generateChunk(const glm::ivec3& pos);
-  void createNoiseChunk(const glm::ivec3 &pos);
+  // Without a regionStorage every chunk is generated and nothing is saved
+  explicit ChunkHandler(JobSystem &jobSystem, RegionStorage *regionStorage = nullptr);
+  ~ChunkHandler();
+
+  ChunkHandler(const ChunkHandler &) = delete;
+  ChunkHandler &operator=(const ChunkHandler &) = delete;
+
+  // Blocks until every scheduled generation job finished, has to be called from outside the JobSystem
+  void waitIdle();
+
+  void generateChunks(const std::vector<glm::ivec3>& positions);
+  Chunk* createNoiseChunk(const glm::ivec3 &pos);
+  Chunk* acquireChunkOrNoiseChunk(const glm::ivec3 &pos);
+  void releaseChunk(const Chunk* chunk);
+  bool hasChunkOrNoiseChunk(const glm::ivec3 &pos);
 
   Chunk* getChunk(const glm::ivec3& pos);
 
+  bool setFocus(const glm::vec3& chunkSpacePos, const glm::vec3& viewDir, float rangeSq);
   void addChunkToQueue(const glm::ivec3& pos);
   bool isChunkInQueue(const glm::ivec3& pos);
+  bool popChunkBatch(std::vector<glm::ivec3>& outPositions);
+
+  std::vector<Chunk*> getChunksGenerated();
+  std::vector<Chunk*> takeChunksToUpload();
 
-  std::vector<Chunk*>& getChunksGenerated();
+  bool unloadChunk(const glm::ivec3& pos);
+  size_t unloadNoiseChunks(const std::function<bool(const glm::ivec3&)>& shouldUnload);
+  size_t deleteUnloadedChunks();
+  // Unloaded chunks still waiting for deleteUnloadedChunks, a pinned chunk stays in here
+  size_t getUnloadedChunks();
 
-  std::deque<glm::ivec3>* getChunkGenQueue();
+  // Chunks classified as all air or all solid from the coarse noise alone
+  [[nodiscard]] uint64_t getUniformChunks() const { return uniformChunks; }
+  // Spot checked uniform chunks the full noise disagreed with, the coarse margin is too small if this grows
+  [[nodiscard]] uint64_t getCoarseMisses() const { return coarseMisses; }
 
 private:
+  // Most chunks popped at once, queued neighbours along x share one noise evaluation
+  static constexpr size_t NOISE_BATCH = 4;
+
+  struct QueuedChunk {
+    glm::ivec3 pos;
+    float priority;
+
+    // Inverted so the std heap functions keep the lowest priority value on top
+    bool operator<(const QueuedChunk& other) const { return priority > other.priority; }
+  };
+
+  float getPriority(const glm::ivec3& pos) const;
+  JobHandle scheduleJob(std::function<void()> job, const std::vector<JobHandle> &dependencies = {});
+  void generateVoxels(const std::vector<Chunk*>& chunks);
+  void generateNoise(Chunk* const* chunks, size_t count);
+  void meshChunk(Chunk* chunk);
+
+  JobSystem &jobSystem;
+  RegionStorage *regionStorage;
+  // Jobs scheduled by this handler that haven't finished yet
+  std::atomic<uint32_t> activeJobs{0};
+
+  // Guards chunkGenQueue, chunksQueued and the focus
+  std::mutex queueMutex;
+  // Guards chunksGenerated, chunkMap and chunksToUpload
+  std::mutex chunkMutex;
+  // Guards ghostChunks and chunkUnloadList
+  std::mutex ghostMutex;
 
   // TODO: V2 ChunkHandling
-  std::deque<glm::ivec3> chunkGenList;
+  // Min heap on priority, lower is generated first
+  std::vector<QueuedChunk> chunkGenQueue;
   std::deque<Chunk*> chunkMeshList;
   std::deque<Chunk*> chunkUpdateList;
+  // Unloaded chunks and retired noise chunks, deleted once no job holds a pin on them anymore
   std::deque<Chunk*> chunkUnloadList;
 
+  // Positions that are queued or currently generating, removed once the chunk is in chunkMap
+  std::unordered_set<glm::ivec3, ChunkPosHash> chunksQueued;
+  // Positions still waiting in chunkGenQueue. Neighbours taken into a batch leave their heap entry behind,
+  // popping skips entries that aren't in here anymore.
+  std::unordered_set<glm::ivec3, ChunkPosHash> chunksInQueue;
+
+  // Camera position in chunk space and view direction the queue is ordered by
+  glm::vec3 focusPos{0.0f};
+  glm::vec3 focusDir{0.0f, 0.0f, -1.0f};
+  float focusRangeSq = std::numeric_limits<float>::max();
 
-  std::vector<glm::ivec3> chunksGenerating;
+  ChunkMap chunkMap{};
+  // Noise only chunks, generated but not meshed, so neighbours can cull their border faces
+  ChunkMap ghostChunks{};
 
   std::vector<Chunk*> chunksGenerated;
+  std::vector<Chunk*> chunksToUpload;
   std::vector<Chunk*> chunksLoaded;
+
+  std::atomic<uint64_t> uniformChunks{0};
+  std::atomic<uint64_t> coarseMisses{0};
 };
@@ -0,0 +1,95 @@
+#include "ChunkMap.hpp"
+
+static size_t nextPowerOfTwo(size_t v) {
+  size_t p = 16;
+  while (p < v) p <<= 1;
+  return p;
+}
+
+ChunkMap::ChunkMap(size_t initialCapacity) {
+  slots.resize(nextPowerOfTwo(initialCapacity));
+}
+
+Chunk *ChunkMap::find(const glm::ivec3 &pos) const {
+  const size_t mask = slots.size() - 1;
+  for (size_t i = slotFor(pos);; i = (i + 1) & mask) {
+    const Slot &slot = slots[i];
+    if (slot.chunk == nullptr) return nullptr;
+    if (slot.pos == pos) return slot.chunk;
+  }
+}
+
+/**
+ *  @brief Inserts the chunk, returns false if there already is a chunk at this position.
+ **/
+bool ChunkMap::insert(const glm::ivec3 &pos, Chunk *chunk) {
+  if (chunk == nullptr) return false;
+
+  // Keep the load factor at or below 0.5, probe chains stay short
+  if ((count + 1) * 2 > slots.size()) rehash(slots.size() * 2);
+
+  const size_t mask = slots.size() - 1;
+  for (size_t i = slotFor(pos);; i = (i + 1) & mask) {
+    Slot &slot = slots[i];
+    if (slot.chunk == nullptr) {
+      slot.pos = pos;
+      slot.chunk = chunk;
+      ++count;
+      return true;
+    }
+    if (slot.pos == pos) return false;
+  }
+}
+
+/**
+ *  @brief Removes the chunk at the given position and returns it (nullptr if there was none).
+ **/
+Chunk *ChunkMap::erase(const glm::ivec3 &pos) {
+  const size_t mask = slots.size() - 1;
+  size_t i = slotFor(pos);
+  for (;; i = (i + 1) & mask) {
+    if (slots[i].chunk == nullptr) return nullptr;
+    if (slots[i].pos == pos) break;
+  }
+
+  Chunk *removed = slots[i].chunk;
+  slots[i].chunk = nullptr;
+  --count;
+
+  // Backward shift following entries into the hole if that moves them closer to their home slot
+  size_t hole = i;
+  for (size_t j = (i + 1) & mask; slots[j].chunk != nullptr; j = (j + 1) & mask) {
+    size_t home = slotFor(slots[j].pos);
+    // Is home cyclically outside of (hole, j]? Then the entry may move into the hole.
+    bool movable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+    if (movable) {
+      slots[hole] = slots[j];
+      slots[j].chunk = nullptr;
+      hole = j;
+    }
+  }
+
+  return removed;
+}
+
+void ChunkMap::clear() {
+  for (Slot &slot: slots) slot.chunk = nullptr;
+  count = 0;
+}
+
+size_t ChunkMap::size() const {
+  return count;
+}
+
+bool ChunkMap::empty() const {
+  return count == 0;
+}
+
+void ChunkMap::rehash(size_t newCapacity) {
+  std::vector<Slot> old = std::move(slots);
+  slots.assign(nextPowerOfTwo(newCapacity), Slot{});
+  count = 0;
+  for (const Slot &slot: old) {
+    if (slot.chunk != nullptr) insert(slot.pos, slot.chunk);
+  }
+}
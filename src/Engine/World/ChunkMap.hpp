@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class Chunk;
+
+/**
+ *  @brief Hash functor for chunk positions, usable with the std containers as well.
+ **/
+struct ChunkPosHash {
+  inline size_t operator()(const glm::ivec3 &pos) const {
+    // Large primes from "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+    auto h = static_cast<uint32_t>(pos.x) * 73856093u
+             ^ static_cast<uint32_t>(pos.y) * 19349663u
+             ^ static_cast<uint32_t>(pos.z) * 83492791u;
+    // Finalizer so neighbouring positions don't end up in neighbouring slots
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+  }
+};
+
+/**
+ *  @brief Open addressing (linear probing) hash map from chunk position to chunk.
+ *  Lookup, insert and erase are O(1) on average, erasing uses backward shifting so no tombstones pile up.
+ *  This is not thread safe, the owner has to synchronize access.
+ **/
+class ChunkMap {
+public:
+  explicit ChunkMap(size_t initialCapacity = 1024);
+
+  [[nodiscard]] Chunk *find(const glm::ivec3 &pos) const;
+  bool insert(const glm::ivec3 &pos, Chunk *chunk);
+  Chunk *erase(const glm::ivec3 &pos);
+  void clear();
+
+  [[nodiscard]] size_t size() const;
+  [[nodiscard]] bool empty() const;
+
+  template<typename F>
+  void forEach(F &&function) const {
+    for (const Slot &slot: slots) {
+      if (slot.chunk != nullptr) function(slot.pos, slot.chunk);
+    }
+  }
+
+private:
+  struct Slot {
+    glm::ivec3 pos{};
+    Chunk *chunk = nullptr;
+  };
+
+  [[nodiscard]] inline size_t slotFor(const glm::ivec3 &pos) const {
+    return ChunkPosHash{}(pos) & (slots.size() - 1);
+  }
+
+  void rehash(size_t newCapacity);
+
+  std::vector<Slot> slots{};
+  size_t count = 0;
+};
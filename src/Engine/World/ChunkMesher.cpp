@@ -0,0 +1,403 @@
+#include "ChunkMesher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include "Block/CubeDefinition.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Runtime selected meshing mode, read by the builder threads
+static std::atomic<MeshingMode> meshingMode{MeshingMode::NAIVE};
+
+static std::array<ChunkMesher::MeshingStats, 3> meshingStats{};
+
+// Written once on startup, read by every builder thread
+static std::array<std::atomic<uint32_t>, MAX_TEXTURED_MATERIALS> materialTextures{};
+
+/**
+ *  @brief Describes one of the six faces of a voxel.
+ *  uAxis is the axis from the faces lower left to lower right vertex (quad width),
+ *  vAxis the one from lower left to upper left (quad height).
+ **/
+struct FaceDefinition {
+  const std::vector<signed char> *vertices;
+  int normalAxis;
+  int normalDir;
+  int uAxis;
+  int vAxis;
+};
+
+static const std::array<FaceDefinition, 6> faces = {{
+  {&topFace, 1, 1, 0, 2},
+  {&botFace, 1, -1, 0, 2},
+  {&frontFace, 2, 1, 0, 1},
+  {&backFace, 2, -1, 0, 1},
+  {&rightFace, 0, 1, 2, 1},
+  {&leftFace, 0, -1, 2, 1},
+}};
+
+static inline bool solid(Material mat) {
+  return mat.id > 0;
+}
+
+/**
+ *  @brief Appends one quad to the mesh. origin is the min corner of the quad, width and height are in voxels.
+ *  The face template is scaled along its u/v axes so merged quads keep the winding of a single face.
+ **/
+static void emitQuad(ChunkMesh &out, const FaceDefinition &face, const glm::ivec3 &origin, int width, int height,
+                     unsigned int texture, unsigned int lightLevel) {
+  glm::ivec3 scale{1};
+  scale[face.uAxis] = width;
+  scale[face.vAxis] = height;
+
+  const std::vector<signed char> &verts = *face.vertices;
+  const auto firstIndex = static_cast<uint32_t>(out.vertices.size());
+
+  // Quad extents for tiling the texture over merged faces
+  const unsigned int quad = width | height << 6;
+
+  for (unsigned int i = 0; i < 4; i++) {
+    unsigned int vertX = verts[i * 3 + 0] * scale.x + origin.x;
+    unsigned int vertY = verts[i * 3 + 1] * scale.y + origin.y;
+    unsigned int vertZ = verts[i * 3 + 2] * scale.z + origin.z;
+    unsigned int vert = vertX | vertY << 6 | vertZ << 12 | lightLevel << 18 | i << 21 | texture << 23;
+    out.vertices.emplace_back(BlockVertex{vert, quad});
+  }
+  for (unsigned int i: faceIndices) {
+    out.indices.push_back(i + firstIndex);
+  }
+}
+
+/**
+ *  @brief Whether the face of the solid voxel at pos pointing into the faces direction is visible.
+ *  Border faces look into the padding shell, so faces covered by a neighbour chunk are culled as well.
+ **/
+static inline bool isFaceVisible(const ChunkMesher::PaddedVolume &volume, const FaceDefinition &face, glm::ivec3 pos) {
+  pos[face.normalAxis] += face.normalDir;
+  return !solid(volume.get(pos.x, pos.y, pos.z));
+}
+
+/**
+ *  @brief Copies the chunk into the padded volume and fills the shell with the border layers of the neighbours.
+ *  Missing neighbours count as solid (see VoxelBoundaryAccess::getBlockAcross).
+ **/
+void ChunkMesher::buildPaddedVolume(const Chunk &chunk, const ChunkNeighbours &neighbours, PaddedVolume &volume) {
+  for (int z = 0; z < CHUNK_SIZE; ++z) {
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+      for (int x = 0; x < CHUNK_SIZE; ++x) {
+        volume.set(x, y, z, chunk.getBlockUnsafe(x, y, z));
+      }
+    }
+  }
+
+  // Voxel x runs along world Z and voxel z along world X, so the x shell borders the NORTH/SOUTH neighbours
+  const int last = CHUNK_SIZE - 1;
+  const Chunk *north = neighbours.get(Direction::NORTH);
+  const Chunk *south = neighbours.get(Direction::SOUTH);
+  const Chunk *west = neighbours.get(Direction::WEST);
+  const Chunk *east = neighbours.get(Direction::EAST);
+  const Chunk *down = neighbours.get(Direction::DOWN);
+  const Chunk *up = neighbours.get(Direction::UP);
+  for (int a = 0; a < CHUNK_SIZE; ++a) {
+    for (int b = 0; b < CHUNK_SIZE; ++b) {
+      volume.set(-1, a, b, VoxelBoundaryAccess::getBlockAcross(north, Direction::NORTH, {0, a, b}));
+      volume.set(CHUNK_SIZE, a, b, VoxelBoundaryAccess::getBlockAcross(south, Direction::SOUTH, {last, a, b}));
+      volume.set(a, b, -1, VoxelBoundaryAccess::getBlockAcross(west, Direction::WEST, {a, b, 0}));
+      volume.set(a, b, CHUNK_SIZE, VoxelBoundaryAccess::getBlockAcross(east, Direction::EAST, {a, b, last}));
+      volume.set(a, -1, b, VoxelBoundaryAccess::getBlockAcross(down, Direction::DOWN, {a, 0, b}));
+      volume.set(a, CHUNK_SIZE, b, VoxelBoundaryAccess::getBlockAcross(up, Direction::UP, {a, last, b}));
+    }
+  }
+}
+
+void ChunkMesher::meshNaive(const PaddedVolume &volume, ChunkMesh &out) {
+  const unsigned int lightLevel = 1;
+
+  for (int z = 0; z < CHUNK_SIZE; ++z) {
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+      for (int x = 0; x < CHUNK_SIZE; ++x) {
+        const Material mat = volume.get(x, y, z);
+        if (!solid(mat)) continue;
+
+        const unsigned int texture = getMaterialTexture(mat);
+
+        glm::ivec3 vpos{x, y, z};
+        for (const FaceDefinition &face: faces) {
+          if (isFaceVisible(volume, face, vpos)) emitQuad(out, face, vpos, 1, 1, texture, lightLevel);
+        }
+      }
+    }
+  }
+}
+
+/**
+ *  @brief Greedy mesher, builds a 2D mask of visible faces for every slice along each face normal
+ *  and merges equal neighbouring entries into the largest rectangles it can find (first along u, then along v).
+ **/
+void ChunkMesher::meshGreedy(const PaddedVolume &volume, ChunkMesh &out) {
+  const unsigned int lightLevel = 1;
+
+  // Material id + 1 of the visible face at (u, v), 0 means no face
+  std::array<uint32_t, CHUNK_SIZE * CHUNK_SIZE> mask{};
+
+  for (const FaceDefinition &face: faces) {
+    for (int slice = 0; slice < CHUNK_SIZE; ++slice) {
+
+      // Build the face mask for this slice
+      for (int v = 0; v < CHUNK_SIZE; ++v) {
+        for (int u = 0; u < CHUNK_SIZE; ++u) {
+          glm::ivec3 pos{};
+          pos[face.normalAxis] = slice;
+          pos[face.uAxis] = u;
+          pos[face.vAxis] = v;
+
+          Material mat = volume.get(pos.x, pos.y, pos.z);
+          bool visible = solid(mat) && isFaceVisible(volume, face, pos);
+          mask[u + v * CHUNK_SIZE] = visible ? mat.id + 1 : 0;
+        }
+      }
+
+      // Merge the mask into quads
+      for (int v = 0; v < CHUNK_SIZE; ++v) {
+        for (int u = 0; u < CHUNK_SIZE;) {
+          const uint32_t current = mask[u + v * CHUNK_SIZE];
+          if (current == 0) {
+            ++u;
+            continue;
+          }
+
+          int width = 1;
+          while (u + width < CHUNK_SIZE && mask[u + width + v * CHUNK_SIZE] == current) ++width;
+
+          int height = 1;
+          for (; v + height < CHUNK_SIZE; ++height) {
+            bool rowMatches = true;
+            for (int k = 0; k < width; ++k) {
+              if (mask[u + k + (v + height) * CHUNK_SIZE] != current) {
+                rowMatches = false;
+                break;
+              }
+            }
+            if (!rowMatches) break;
+          }
+
+          glm::ivec3 origin{};
+          origin[face.normalAxis] = slice;
+          origin[face.uAxis] = u;
+          origin[face.vAxis] = v;
+          emitQuad(out, face, origin, width, height, getMaterialTexture(Material{current - 1}), lightLevel);
+
+          // Clear the merged area so it does not get emitted again
+          for (int h = 0; h < height; ++h) {
+            for (int k = 0; k < width; ++k) {
+              mask[u + k + (v + h) * CHUNK_SIZE] = 0;
+            }
+          }
+          u += width;
+        }
+      }
+    }
+  }
+}
+
+// A padded column has to fit into a single 64 bit mask
+static_assert(PADDED_CHUNK_SIZE <= 64, "Binary mesher needs CHUNK_SIZE + 2 <= 64");
+
+static inline int countTrailingZeros(uint64_t v) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, v);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(v);
+#endif
+}
+
+/**
+ *  @brief Binary greedy mesher.
+ *  Solidity is stored as one 64 bit column per (u, v) for every axis (bit = position along the axis, shell included).
+ *  Visible faces of a whole column are then found at once with col & ~(col >> 1) (positive direction) and
+ *  col & ~(col << 1) (negative direction). The face bits get transposed into per slice row masks which are
+ *  merged into quads with bit scans.
+ *  @param singleMaterial True if the chunk holds at most one solid material, skips all material comparisons
+ **/
+void ChunkMesher::meshBinary(const PaddedVolume &volume, bool singleMaterial, ChunkMesh &out) {
+  const unsigned int lightLevel = 1;
+
+  constexpr int P = PADDED_CHUNK_SIZE;
+  constexpr uint64_t chunkMask = (1ull << CHUNK_SIZE) - 1;
+
+  // Solidity columns along each axis, indexed [v * P + u] with the u/v axes of the faces on that axis (padded coords)
+  thread_local std::array<std::array<uint64_t, P * P>, 3> columns{};
+  // Visible face rows per slice, [slice][v] with bit u set
+  thread_local std::array<std::array<uint64_t, CHUNK_SIZE>, CHUNK_SIZE> planes{};
+
+  for (auto &axis: columns) axis.fill(0);
+
+  for (int z = 0; z < P; ++z) {
+    for (int y = 0; y < P; ++y) {
+      const Material *row = &volume.voxels[y * P + z * P * P];
+      uint64_t xColumn = 0;
+      for (int x = 0; x < P; ++x) {
+        // Branchless, terrain is too noisy for the branch predictor
+        const uint64_t isSolid = solid(row[x]);
+        xColumn |= isSolid << x;                // X axis: u = Z, v = Y
+        columns[1][z * P + x] |= isSolid << y;  // Y axis: u = X, v = Z
+        columns[2][y * P + x] |= isSolid << z;  // Z axis: u = X, v = Y
+      }
+      columns[0][y * P + z] = xColumn;
+    }
+  }
+
+  for (const FaceDefinition &face: faces) {
+    for (auto &plane: planes) plane.fill(0);
+
+    const std::array<uint64_t, P * P> &axisColumns = columns[face.normalAxis];
+
+    // Face culling for whole columns, then transpose the face bits into the slice planes
+    for (int v = 0; v < CHUNK_SIZE; ++v) {
+      for (int u = 0; u < CHUNK_SIZE; ++u) {
+        const uint64_t col = axisColumns[(v + 1) * P + (u + 1)];
+        uint64_t visible = face.normalDir > 0 ? col & ~(col >> 1) : col & ~(col << 1);
+        visible = (visible >> 1) & chunkMask; // Drop the shell bits
+
+        while (visible != 0) {
+          const int slice = countTrailingZeros(visible);
+          planes[slice][v] |= 1ull << u;
+          visible &= visible - 1;
+        }
+      }
+    }
+
+    for (int slice = 0; slice < CHUNK_SIZE; ++slice) {
+      std::array<uint64_t, CHUNK_SIZE> &plane = planes[slice];
+
+      const auto materialAt = [&](int u, int v) {
+        glm::ivec3 pos{};
+        pos[face.normalAxis] = slice;
+        pos[face.uAxis] = u;
+        pos[face.vAxis] = v;
+        return volume.get(pos.x, pos.y, pos.z);
+      };
+
+      for (int v = 0; v < CHUNK_SIZE; ++v) {
+        uint64_t row = plane[v];
+        while (row != 0) {
+          const int u = countTrailingZeros(row);
+          // Looked up once per quad for its texture, the run comparisons are skipped for single material chunks
+          const Material material = materialAt(u, v);
+
+          // Width: run of set bits (with the same material) starting at u
+          int width = countTrailingZeros(~(row >> u));
+          if (!singleMaterial) {
+            for (int k = 1; k < width; ++k) {
+              if (materialAt(u + k, v) != material) {
+                width = k;
+                break;
+              }
+            }
+          }
+          const uint64_t runMask = (width >= 64 ? ~0ull : ((1ull << width) - 1)) << u;
+
+          // Height: following rows that contain the whole run
+          int height = 1;
+          for (; v + height < CHUNK_SIZE; ++height) {
+            if ((plane[v + height] & runMask) != runMask) break;
+            if (!singleMaterial) {
+              bool sameMaterial = true;
+              for (int k = 0; k < width && sameMaterial; ++k) {
+                sameMaterial = materialAt(u + k, v + height) == material;
+              }
+              if (!sameMaterial) break;
+            }
+            plane[v + height] &= ~runMask;
+          }
+
+          glm::ivec3 origin{};
+          origin[face.normalAxis] = slice;
+          origin[face.uAxis] = u;
+          origin[face.vAxis] = v;
+          emitQuad(out, face, origin, width, height, getMaterialTexture(material), lightLevel);
+
+          row &= ~runMask;
+        }
+      }
+    }
+  }
+}
+
+/**
+ *  @brief Meshes the chunk with the currently selected MeshingMode and records timing/vertex statistics.
+ *  Faces on the chunk border are culled against the given neighbours.
+ **/
+void ChunkMesher::mesh(const Chunk &chunk, const ChunkNeighbours &neighbours, ChunkMesh &out) {
+  const MeshingMode mode = getMode();
+  const auto start = std::chrono::steady_clock::now();
+
+  out.vertices.clear();
+  out.indices.clear();
+
+  // Reused per builder thread, the padded volume is too big to allocate for every chunk
+  thread_local PaddedVolume volume{};
+  buildPaddedVolume(chunk, neighbours, volume);
+
+  switch (mode) {
+    case MeshingMode::NAIVE:
+      meshNaive(volume, out);
+      break;
+    case MeshingMode::GREEDY:
+      meshGreedy(volume, out);
+      break;
+    case MeshingMode::BINARY: {
+      // Stale palette entries only cost us the single material fast path
+      const std::vector<Material> &palette = chunk.getBlocks().getPalette();
+      const auto solidMaterials = std::count_if(palette.begin(), palette.end(), solid);
+      meshBinary(volume, solidMaterials <= 1, out);
+    }
+      break;
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  MeshingStats &stats = getStats(mode);
+  stats.chunks++;
+  stats.vertices += out.vertices.size();
+  stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+MeshingMode ChunkMesher::getMode() {
+  return meshingMode.load(std::memory_order_relaxed);
+}
+
+void ChunkMesher::setMode(MeshingMode mode) {
+  meshingMode.store(mode, std::memory_order_relaxed);
+}
+
+const char *ChunkMesher::getModeName(MeshingMode mode) {
+  switch (mode) {
+    case MeshingMode::NAIVE:
+      return "Naive";
+    case MeshingMode::GREEDY:
+      return "Greedy";
+    case MeshingMode::BINARY:
+      return "Binary";
+  }
+  return "Unknown";
+}
+
+ChunkMesher::MeshingStats &ChunkMesher::getStats(MeshingMode mode) {
+  return meshingStats[static_cast<size_t>(mode)];
+}
+
+void ChunkMesher::setMaterialTexture(Material material, uint32_t layer) {
+  if (material.id >= MAX_TEXTURED_MATERIALS) return;
+  materialTextures[material.id].store(layer, std::memory_order_relaxed);
+}
+
+uint32_t ChunkMesher::getMaterialTexture(Material material) {
+  return material.id < MAX_TEXTURED_MATERIALS ? materialTextures[material.id].load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <vector>
+
+#include "Chunk.hpp"
+#include "VoxelAccess.hpp"
+
+enum class MeshingMode {
+  NAIVE,  // One quad per visible voxel face
+  GREEDY, // Coplanar faces with the same material merged into larger quads
+  BINARY  // Greedy quads, face visibility found with 64 bit column masks instead of per voxel neighbour lookups
+};
+
+inline const int PADDED_CHUNK_SIZE = CHUNK_SIZE + 2;
+// Materials with a higher id are drawn with texture layer 0
+inline const uint32_t MAX_TEXTURED_MATERIALS = 256;
+
+namespace ChunkMesher {
+
+  /**
+   *  @brief Chunk voxels plus a one voxel shell sampled from the six neighbours.
+   *  Coordinates are chunk local and range from -1 to CHUNK_SIZE. Shell edges and corners are never read.
+   **/
+  struct PaddedVolume {
+    std::vector<Material> voxels = std::vector<Material>(PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE);
+
+    [[nodiscard]] inline Material get(int x, int y, int z) const {
+      return voxels[(x + 1) + (y + 1) * PADDED_CHUNK_SIZE + (z + 1) * PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE];
+    }
+
+    inline void set(int x, int y, int z, Material material) {
+      voxels[(x + 1) + (y + 1) * PADDED_CHUNK_SIZE + (z + 1) * PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE] = material;
+    }
+  };
+
+  struct MeshingStats {
+    std::atomic<uint64_t> chunks{0};
+    std::atomic<uint64_t> vertices{0};
+    std::atomic<uint64_t> nanoseconds{0};
+  };
+
+  void mesh(const Chunk &chunk, const ChunkNeighbours &neighbours, ChunkMesh &out);
+
+  void buildPaddedVolume(const Chunk &chunk, const ChunkNeighbours &neighbours, PaddedVolume &volume);
+
+  void meshNaive(const PaddedVolume &volume, ChunkMesh &out);
+  void meshGreedy(const PaddedVolume &volume, ChunkMesh &out);
+  void meshBinary(const PaddedVolume &volume, bool singleMaterial, ChunkMesh &out);
+
+  MeshingMode getMode();
+  void setMode(MeshingMode mode);
+  const char *getModeName(MeshingMode mode);
+
+  MeshingStats &getStats(MeshingMode mode);
+
+  // Texture array layer the faces of material are drawn with, has to be set before chunks get meshed
+  void setMaterialTexture(Material material, uint32_t layer);
+  uint32_t getMaterialTexture(Material material);
+}
@@ -0,0 +1,95 @@
+#include "ChunkVisibility.hpp"
+#include "VoxelAccess.hpp"
+
+#include <vector>
+
+ChunkVisibility ChunkVisibility::open() {
+  ChunkVisibility visibility{};
+  // All 36 face pairs
+  visibility.connections = (uint64_t{1} << 36) - 1;
+  return visibility;
+}
+
+void ChunkVisibility::connect(Direction a, Direction b) {
+  connections |= uint64_t{1} << (static_cast<int>(a) * 6 + static_cast<int>(b));
+  connections |= uint64_t{1} << (static_cast<int>(b) * 6 + static_cast<int>(a));
+}
+
+/**
+ *  @brief Flood fills every air region that touches the chunk border and connects all faces the region touches.
+ *  Enclosed air pockets can't be seen from outside, so they are skipped.
+ **/
+ChunkVisibility ChunkVisibility::compute(const Chunk &chunk) {
+  const VoxelStorage &blocks = chunk.getBlocks();
+  if (blocks.isUniform()) {
+    return blocks.get(0) == Materials::AIR ? open() : ChunkVisibility{};
+  }
+
+  ChunkVisibility visibility{};
+  std::vector<uint8_t> visited(CHUNK_VOLUME, 0);
+  std::vector<uint32_t> stack;
+
+  // Voxel x runs along world Z and voxel z along world X, like in VoxelBoundaryAccess::getBlockAcross
+  auto faceMask = [](int x, int y, int z) {
+    uint32_t mask = 0;
+    if (x == 0) mask |= 1u << static_cast<int>(Direction::NORTH);
+    if (z == CHUNK_SIZE - 1) mask |= 1u << static_cast<int>(Direction::EAST);
+    if (x == CHUNK_SIZE - 1) mask |= 1u << static_cast<int>(Direction::SOUTH);
+    if (z == 0) mask |= 1u << static_cast<int>(Direction::WEST);
+    if (y == CHUNK_SIZE - 1) mask |= 1u << static_cast<int>(Direction::UP);
+    if (y == 0) mask |= 1u << static_cast<int>(Direction::DOWN);
+    return mask;
+  };
+
+  auto fill = [&](uint32_t seed) {
+    uint32_t touched = 0;
+    visited[seed] = 1;
+    stack.push_back(seed);
+
+    while (!stack.empty()) {
+      const uint32_t index = stack.back();
+      stack.pop_back();
+
+      const int x = static_cast<int>(index % CHUNK_SIZE);
+      const int y = static_cast<int>((index / CHUNK_SIZE) % CHUNK_SIZE);
+      const int z = static_cast<int>(index / (CHUNK_SIZE * CHUNK_SIZE));
+      touched |= faceMask(x, y, z);
+
+      for (const glm::ivec3 &offset: directionOffsets) {
+        const glm::ivec3 n = glm::ivec3{x, y, z} + offset;
+        if (n.x < 0 || n.y < 0 || n.z < 0 || n.x >= CHUNK_SIZE || n.y >= CHUNK_SIZE || n.z >= CHUNK_SIZE) continue;
+
+        const uint32_t neighbour = n.x + (n.y * CHUNK_SIZE) + (n.z * CHUNK_SIZE * CHUNK_SIZE);
+        if (visited[neighbour] || blocks.get(neighbour) != Materials::AIR) continue;
+        visited[neighbour] = 1;
+        stack.push_back(neighbour);
+      }
+    }
+
+    for (int a = 0; a < 6; ++a) {
+      if (!(touched & (1u << a))) continue;
+      for (int b = a; b < 6; ++b) {
+        if (touched & (1u << b)) visibility.connect(static_cast<Direction>(a), static_cast<Direction>(b));
+      }
+    }
+  };
+
+  // Only regions reaching the border matter, so seeding from the border voxels is enough
+  for (int z = 0; z < CHUNK_SIZE; ++z) {
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+      for (int x = 0; x < CHUNK_SIZE; ++x) {
+        if (faceMask(x, y, z) == 0) {
+          // Jump straight to the far border of this row
+          x = CHUNK_SIZE - 2;
+          continue;
+        }
+
+        const uint32_t index = x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE);
+        if (visited[index] || blocks.get(index) != Materials::AIR) continue;
+        fill(index);
+      }
+    }
+  }
+
+  return visibility;
+}
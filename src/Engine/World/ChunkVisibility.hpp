@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+class Chunk;
+enum class Direction;
+
+/**
+ *  @brief Which faces of a chunk are connected through air inside of it, so a view entering through one face can
+ *  leave through the other. Computed at mesh time by a flood fill over the air voxels.
+ **/
+class ChunkVisibility {
+public:
+  // Every face sees every other face, used for chunks without voxel data
+  static ChunkVisibility open();
+  static ChunkVisibility compute(const Chunk &chunk);
+
+  [[nodiscard]] inline bool canSee(Direction from, Direction to) const {
+    return (connections >> (static_cast<int>(from) * 6 + static_cast<int>(to))) & 1u;
+  }
+
+  void connect(Direction a, Direction b);
+
+  [[nodiscard]] bool isClosed() const { return connections == 0; }
+
+private:
+  // Bit from * 6 + to, kept symmetric
+  uint64_t connections{0};
+};
@@ -0,0 +1,343 @@
+#include "RegionFile.hpp"
+#include "VoxelStorage.hpp"
+
+#include <Logging/Logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr char REGION_MAGIC[4] = {'V', 'X', 'R', 'G'};
+// Also bumped when the terrain generation changes, old worlds would mix with new terrain otherwise
+static constexpr uint32_t REGION_VERSION = 2;
+
+// Magic, version, region size and a reserved word, followed by the offset table
+static constexpr size_t HEADER_PREFIX = 16;
+static constexpr uint32_t HEADER_BYTES = HEADER_PREFIX + REGION_VOLUME * 2 * sizeof(uint32_t);
+
+// Largest palette a VoxelStorage can index with 16 bits
+static constexpr uint32_t MAX_PALETTE_SIZE = 65536;
+
+/**
+ *  @brief Bounds checked cursor over a record, any read past the end clears ok and returns 0.
+ **/
+struct RecordReader {
+  const uint8_t *pos;
+  const uint8_t *end;
+  bool ok = true;
+
+  uint32_t u32() {
+    if (end - pos < 4) {
+      ok = false;
+      return 0;
+    }
+    uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    pos += 4;
+    return value;
+  }
+
+  uint32_t varint() {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      if (pos == end) break;
+      const uint8_t byte = *pos++;
+      value |= static_cast<uint32_t>(byte & 0x7Fu) << shift;
+      if ((byte & 0x80u) == 0) return value;
+    }
+    ok = false;
+    return 0;
+  }
+};
+
+static void putU32(std::vector<uint8_t> &out, uint32_t value) {
+  uint8_t bytes[4];
+  std::memcpy(bytes, &value, sizeof(value));
+  out.insert(out.end(), bytes, bytes + 4);
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint32_t value) {
+  while (value >= 0x80u) {
+    out.push_back(static_cast<uint8_t>(value | 0x80u));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+RegionFile::~RegionFile() {
+  close();
+}
+
+/**
+ *  @brief Opens the region file at path and maps it, a missing file is only created if create is set.
+ *  A file that is damaged or of another version is ignored, with create set it is moved aside to path.old and
+ *  replaced by an empty region so saves still reach the disk. Returns false if there is no usable file.
+ **/
+bool RegionFile::open(const std::string &filePath, bool create) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  path = filePath;
+  table.assign(REGION_VOLUME, Entry{0, 0});
+  endOffset = HEADER_BYTES;
+
+  stream.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (stream.is_open()) {
+    std::vector<uint8_t> header(HEADER_BYTES);
+    stream.read(reinterpret_cast<char *>(header.data()), static_cast<std::streamsize>(header.size()));
+
+    uint32_t version = 0;
+    uint32_t regionSize = 0;
+    std::memcpy(&version, header.data() + 4, sizeof(uint32_t));
+    std::memcpy(&regionSize, header.data() + 8, sizeof(uint32_t));
+    if (stream && std::memcmp(header.data(), REGION_MAGIC, sizeof(REGION_MAGIC)) == 0 &&
+        version == REGION_VERSION && regionSize == static_cast<uint32_t>(REGION_SIZE)) {
+      std::memcpy(table.data(), header.data() + HEADER_PREFIX, REGION_VOLUME * sizeof(Entry));
+      for (const Entry &entry: table) {
+        if (entry.size == 0) continue;
+        endOffset = std::max(endOffset, entry.offset + entry.size);
+      }
+      return remap();
+    }
+
+    stream.close();
+    if (!create) {
+      LOG(W, "Ignoring region file " << path << ", it is damaged or of another version");
+      return false;
+    }
+
+    // Kept instead of overwritten, an older build can still read it
+    const std::string oldPath = path + ".old";
+    std::remove(oldPath.c_str());
+    if (std::rename(path.c_str(), oldPath.c_str()) != 0) {
+      LOG(E, "Failed to move region file " << path << " aside, it is damaged or of another version");
+      return false;
+    }
+    LOG(W, "Moved region file " << path << " to " << oldPath << ", it is damaged or of another version");
+  } else if (!create) {
+    return false;
+  }
+
+  std::ofstream created(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!created.is_open()) {
+    LOG(E, "Failed to create region file " << path);
+    return false;
+  }
+  std::vector<uint8_t> header(HEADER_BYTES, 0);
+  std::memcpy(header.data(), REGION_MAGIC, sizeof(REGION_MAGIC));
+  std::memcpy(header.data() + 4, &REGION_VERSION, sizeof(uint32_t));
+  const auto regionSize = static_cast<uint32_t>(REGION_SIZE);
+  std::memcpy(header.data() + 8, &regionSize, sizeof(uint32_t));
+  created.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+  created.close();
+
+  stream.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!stream.is_open()) return false;
+
+  return remap();
+}
+
+void RegionFile::close() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  unmap();
+  if (stream.is_open()) stream.close();
+}
+
+bool RegionFile::contains(uint32_t slot) {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return slot < table.size() && table[slot].size != 0;
+}
+
+/**
+ *  @brief Decodes the record of slot from the mapping into outStorage, returns false if the chunk isn't stored or the
+ *  record is damaged. outStorage is undefined after a failed decode.
+ **/
+bool RegionFile::read(uint32_t slot, VoxelStorage &outStorage) {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (slot >= table.size() || table[slot].size == 0) return false;
+
+  // Written after the file was mapped
+  auto isMapped = [&] { return static_cast<size_t>(table[slot].offset) + table[slot].size <= viewSize; };
+  if (!isMapped()) {
+    lock.unlock();
+    {
+      // Another reader might have remapped in the meantime
+      std::unique_lock<std::shared_mutex> writeLock(mutex);
+      if (!isMapped()) remap();
+    }
+    lock.lock();
+  }
+
+  const Entry entry = table[slot];
+  if (view == nullptr || static_cast<size_t>(entry.offset) + entry.size > viewSize) return false;
+
+  if (!decode(view + entry.offset, entry.size, outStorage)) {
+    LOG(W, "Damaged chunk record " << slot << " in " << path);
+    return false;
+  }
+  return true;
+}
+
+/**
+ *  @brief Appends the record to the file and points the offset table at it.
+ *  Records are never overwritten in place, a crash while writing leaves the previous record of the chunk intact.
+ **/
+bool RegionFile::write(uint32_t slot, const std::vector<uint8_t> &record) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  if (!stream.is_open() || slot >= table.size() || record.empty()) return false;
+
+  if (static_cast<uint64_t>(endOffset) + record.size() > UINT32_MAX) {
+    LOG_FIRST(E, 1, "Region file " << path << " is full");
+    return false;
+  }
+  const Entry entry{endOffset, static_cast<uint32_t>(record.size())};
+
+  stream.seekp(static_cast<std::streamoff>(entry.offset));
+  stream.write(reinterpret_cast<const char *>(record.data()), static_cast<std::streamsize>(record.size()));
+  stream.flush();
+  // Only once the record is on disk
+  stream.seekp(static_cast<std::streamoff>(HEADER_PREFIX + slot * sizeof(Entry)));
+  stream.write(reinterpret_cast<const char *>(&entry), sizeof(Entry));
+  stream.flush();
+
+  if (!stream) {
+    LOG(E, "Failed to write chunk record " << slot << " to " << path);
+    stream.clear();
+    return false;
+  }
+
+  table[slot] = entry;
+  endOffset += entry.size;
+  return true;
+}
+
+size_t RegionFile::getFileSize() {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return endOffset;
+}
+
+/**
+ *  @brief Maps the whole file read-only, the mutex has to be held exclusively.
+ **/
+bool RegionFile::remap() {
+  unmap();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) return false;
+
+  // The view keeps the mapping alive
+  void *mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (mapped == nullptr) return false;
+
+  viewSize = static_cast<size_t>(size.QuadPart);
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info{};
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  viewSize = static_cast<size_t>(info.st_size);
+#endif
+
+  view = static_cast<const uint8_t *>(mapped);
+  return true;
+}
+
+void RegionFile::unmap() {
+  if (view == nullptr) return;
+#ifdef _WIN32
+  UnmapViewOfFile(view);
+#else
+  munmap(const_cast<uint8_t *>(view), viewSize);
+#endif
+  view = nullptr;
+  viewSize = 0;
+}
+
+/**
+ *  @brief Palette followed by (run length, palette index) varint pairs in storage order, a uniform storage has no runs.
+ **/
+std::vector<uint8_t> RegionFile::encode(const VoxelStorage &storage) {
+  const std::vector<Material> &palette = storage.getPalette();
+  const uint32_t volume = storage.getVolume();
+
+  std::vector<uint8_t> out;
+  out.reserve(8 + palette.size() * sizeof(uint32_t) + (storage.isUniform() ? 0 : 256));
+  putU32(out, volume);
+  putU32(out, static_cast<uint32_t>(palette.size()));
+  for (const Material &material: palette) putU32(out, material.id);
+
+  if (storage.isUniform()) return out;
+
+  uint32_t runIndex = storage.getPaletteIndex(0);
+  uint32_t runLength = 0;
+  for (uint32_t i = 0; i < volume; ++i) {
+    const uint32_t index = storage.getPaletteIndex(i);
+    if (index != runIndex) {
+      putVarint(out, runLength);
+      putVarint(out, runIndex);
+      runIndex = index;
+      runLength = 0;
+    }
+    runLength++;
+  }
+  putVarint(out, runLength);
+  putVarint(out, runIndex);
+  return out;
+}
+
+bool RegionFile::decode(const uint8_t *record, size_t size, VoxelStorage &outStorage) {
+  RecordReader reader{record, record + size};
+
+  const uint32_t volume = reader.u32();
+  const uint32_t paletteSize = reader.u32();
+  if (!reader.ok || volume != outStorage.getVolume() || paletteSize == 0 || paletteSize > MAX_PALETTE_SIZE ||
+      static_cast<size_t>(reader.end - reader.pos) < paletteSize * sizeof(uint32_t)) {
+    return false;
+  }
+
+  std::vector<Material> palette(paletteSize);
+  for (Material &material: palette) material.id = reader.u32();
+  outStorage.assignPalette(std::move(palette));
+  if (paletteSize == 1) return true;
+
+  uint32_t covered = 0;
+  while (covered < volume) {
+    const uint32_t length = reader.varint();
+    const uint32_t index = reader.varint();
+    if (!reader.ok || length == 0 || length > volume - covered || index >= paletteSize) return false;
+    outStorage.setIndexRun(covered, length, index);
+    covered += length;
+  }
+  return true;
+}
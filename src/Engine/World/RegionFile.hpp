@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class VoxelStorage;
+
+inline const int REGION_SIZE = 32;
+#define REGION_VOLUME (REGION_SIZE * REGION_SIZE * REGION_SIZE)
+
+/**
+ *  @brief One file holding the voxels of REGION_SIZE^3 chunks.
+ *  The file starts with a header and an offset table with one entry per chunk, followed by the chunk records. A record
+ *  is the palette of the chunk and its palette indices run length encoded, a uniform chunk takes 12 bytes.
+ *  Reads decode straight out of a read-only memory mapping of the file, writes go through a regular file stream.
+ *  Thread safe, any number of readers or a single writer at a time.
+ **/
+class RegionFile {
+public:
+  RegionFile() = default;
+  ~RegionFile();
+
+  RegionFile(const RegionFile &) = delete;
+  RegionFile &operator=(const RegionFile &) = delete;
+
+  bool open(const std::string &path, bool create);
+  void close();
+
+  [[nodiscard]] bool contains(uint32_t slot);
+  bool read(uint32_t slot, VoxelStorage &outStorage);
+  bool write(uint32_t slot, const std::vector<uint8_t> &record);
+
+  [[nodiscard]] size_t getFileSize();
+
+  static std::vector<uint8_t> encode(const VoxelStorage &storage);
+  static bool decode(const uint8_t *record, size_t size, VoxelStorage &outStorage);
+
+private:
+  struct Entry {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  bool remap();
+  void unmap();
+
+  std::string path;
+  std::fstream stream;
+  std::vector<Entry> table;
+  // End of the last record, new records are appended there
+  uint32_t endOffset{0};
+
+  const uint8_t *view{nullptr};
+  size_t viewSize{0};
+
+  std::shared_mutex mutex;
+};
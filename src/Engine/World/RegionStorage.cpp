@@ -0,0 +1,181 @@
+#include "RegionStorage.hpp"
+#include "Chunk.hpp"
+
+#include <Logging/Logger.h>
+#include <Logging/Profiler.hpp>
+
+#include <filesystem>
+
+static int floorDiv(int value, int divisor) {
+  return (value >= 0 ? value : value - divisor + 1) / divisor;
+}
+
+static glm::ivec3 getRegionPos(const glm::ivec3 &chunkPos) {
+  return {floorDiv(chunkPos.x, REGION_SIZE), floorDiv(chunkPos.y, REGION_SIZE), floorDiv(chunkPos.z, REGION_SIZE)};
+}
+
+static uint32_t getSlot(const glm::ivec3 &chunkPos, const glm::ivec3 &regionPos) {
+  const glm::ivec3 local = chunkPos - regionPos * REGION_SIZE;
+  return static_cast<uint32_t>(local.x + local.y * REGION_SIZE + local.z * REGION_SIZE * REGION_SIZE);
+}
+
+RegionStorage::~RegionStorage() {
+  close();
+}
+
+/**
+ *  @brief Uses worldDirectory for the region files, it is created if it doesn't exist yet.
+ **/
+void RegionStorage::open(const std::string &worldDirectory) {
+  if (opened) close();
+
+  std::error_code error;
+  std::filesystem::create_directories(worldDirectory, error);
+  if (error) {
+    LOG(E, "Failed to create world directory " << worldDirectory << ": " << error.message());
+    return;
+  }
+
+  directory = worldDirectory;
+  stopWriter = false;
+  writer = std::thread(&RegionStorage::writerLoop, this);
+  opened = true;
+  LOG(I, "Storing chunks in " << worldDirectory);
+}
+
+/**
+ *  @brief Writes everything still queued and closes all region files.
+ **/
+void RegionStorage::close() {
+  if (!opened) return;
+  opened = false;
+
+  {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    stopWriter = true;
+  }
+  writeCond.notify_all();
+  writer.join();
+
+  std::lock_guard<std::mutex> lock(regionMutex);
+  regions.clear();
+}
+
+/**
+ *  @brief Fills the chunks voxels from its region file, returns false if it was never saved and has to be generated.
+ **/
+bool RegionStorage::load(Chunk *chunk) {
+  if (!opened) return false;
+
+  const glm::ivec3 pos = chunk->getPos();
+  const glm::ivec3 regionPos = getRegionPos(pos);
+  const uint32_t slot = getSlot(pos, regionPos);
+
+  bool found = false;
+  {
+    // A save that hasn't reached the file yet is the newest state of the chunk
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto it = pendingWrites.find(PendingKey{regionPos, slot});
+    if (it != pendingWrites.end()) {
+      found = RegionFile::decode(it->second->data(), it->second->size(), chunk->getBlocks());
+    }
+  }
+
+  if (!found) {
+    RegionFile *region = getRegion(regionPos, false);
+    found = region != nullptr && region->read(slot, chunk->getBlocks());
+  }
+
+  if (!found) {
+    // A damaged record could have left anything behind
+    chunk->getBlocks().fill(Materials::AIR);
+    return false;
+  }
+
+  chunk->applyLoadedVoxels();
+  loadedChunks++;
+  return true;
+}
+
+/**
+ *  @brief Encodes the chunks voxels right away and queues them for the writer thread. Replaces the record of an
+ *  earlier save of the chunk that wasn't written yet, the chunk keeps its place in the queue.
+ **/
+void RegionStorage::save(Chunk *chunk) {
+  if (!opened) return;
+
+  const glm::ivec3 pos = chunk->getPos();
+  const glm::ivec3 regionPos = getRegionPos(pos);
+  const PendingKey key{regionPos, getSlot(pos, regionPos)};
+  auto record = std::make_shared<const std::vector<uint8_t>>(RegionFile::encode(chunk->getBlocks()));
+  chunk->setModified(false);
+
+  {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto [it, inserted] = pendingWrites.insert_or_assign(key, std::move(record));
+    if (inserted) writeOrder.push_back(key);
+  }
+  writeCond.notify_one();
+}
+
+void RegionStorage::flush() {
+  std::unique_lock<std::mutex> lock(writeMutex);
+  idleCond.wait(lock, [this] { return pendingWrites.empty(); });
+}
+
+size_t RegionStorage::getPendingWrites() {
+  std::lock_guard<std::mutex> lock(writeMutex);
+  return pendingWrites.size();
+}
+
+/**
+ *  @brief Returns the opened region file, nullptr if there is none and create isn't set.
+ **/
+RegionFile *RegionStorage::getRegion(const glm::ivec3 &regionPos, bool create) {
+  std::lock_guard<std::mutex> lock(regionMutex);
+  auto it = regions.find(regionPos);
+  if (it != regions.end() && (it->second != nullptr || !create)) return it->second.get();
+
+  const std::string path = directory + "/r." + std::to_string(regionPos.x) + "." + std::to_string(regionPos.y) + "." +
+                           std::to_string(regionPos.z) + ".vxr";
+  auto region = std::make_unique<RegionFile>();
+  if (!region->open(path, create)) region.reset();
+
+  RegionFile *result = region.get();
+  regions[regionPos] = std::move(region);
+  return result;
+}
+
+/**
+ *  @brief Writes the queued records in order. A record stays pending until it is in the file so load can still find
+ *  it, a chunk saved again while its record was written is queued once more.
+ **/
+void RegionStorage::writerLoop() {
+  Profiler::setThreadName("Region writer");
+  std::unique_lock<std::mutex> lock(writeMutex);
+  while (true) {
+    writeCond.wait(lock, [this] { return stopWriter || !writeOrder.empty(); });
+    // Only stops once everything is written
+    if (writeOrder.empty()) return;
+
+    const PendingKey key = writeOrder.front();
+    writeOrder.pop_front();
+    const PendingRecord record = pendingWrites.at(key);
+    lock.unlock();
+
+    {
+      PROFILE_ZONE("writeChunkRecord");
+      RegionFile *region = getRegion(key.regionPos, true);
+      if (region != nullptr && region->write(key.slot, *record)) savedChunks++;
+    }
+
+    lock.lock();
+    auto it = pendingWrites.find(key);
+    if (it->second == record) {
+      pendingWrites.erase(it);
+    } else {
+      writeOrder.push_back(key);
+    }
+    if (pendingWrites.empty()) idleCond.notify_all();
+  }
+}
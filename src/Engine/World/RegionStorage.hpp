@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "ChunkMap.hpp"
+#include "RegionFile.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+class Chunk;
+
+/**
+ *  @brief Persists chunk voxels in region files inside a world directory.
+ *  Chunks found on disk are decoded instead of generated, so revisiting a known world is bound by I/O and not by
+ *  the noise. Saving encodes on the calling thread and leaves the file writes to a background writer thread.
+ **/
+class RegionStorage {
+public:
+  ~RegionStorage();
+
+  void open(const std::string &worldDirectory);
+  void close();
+
+  [[nodiscard]] bool isOpen() const { return opened; }
+
+  bool load(Chunk *chunk);
+  void save(Chunk *chunk);
+  // Blocks until every queued save hit the disk
+  void flush();
+
+  [[nodiscard]] uint64_t getLoadedChunks() const { return loadedChunks; }
+  [[nodiscard]] uint64_t getSavedChunks() const { return savedChunks; }
+  [[nodiscard]] size_t getPendingWrites();
+
+private:
+  struct PendingKey {
+    glm::ivec3 regionPos;
+    uint32_t slot;
+
+    bool operator==(const PendingKey &other) const { return regionPos == other.regionPos && slot == other.slot; }
+  };
+
+  struct PendingKeyHash {
+    inline size_t operator()(const PendingKey &key) const {
+      return ChunkPosHash{}(key.regionPos) ^ (static_cast<size_t>(key.slot) * 0x9E3779B9u);
+    }
+  };
+
+  // Shared with the writer while it writes, a newer save swaps in its own record
+  using PendingRecord = std::shared_ptr<const std::vector<uint8_t>>;
+
+  RegionFile *getRegion(const glm::ivec3 &regionPos, bool create);
+  void writerLoop();
+
+  std::string directory;
+  bool opened{false};
+
+  // Guards regions, a null entry remembers that there is no file for that region
+  std::mutex regionMutex;
+  std::unordered_map<glm::ivec3, std::unique_ptr<RegionFile>, ChunkPosHash> regions;
+
+  // Guards the pending writes and the writer state
+  std::mutex writeMutex;
+  std::condition_variable writeCond;
+  std::condition_variable idleCond;
+  // Newest unwritten record of every saved chunk, load looks here before it reads the file
+  std::unordered_map<PendingKey, PendingRecord, PendingKeyHash> pendingWrites;
+  // Keys in the order they were first saved, a key being written is in neither
+  std::deque<PendingKey> writeOrder;
+  bool stopWriter{false};
+  std::thread writer;
+
+  std::atomic<uint64_t> loadedChunks{0};
+  std::atomic<uint64_t> savedChunks{0};
+};
@@ -0,0 +1,88 @@
+#include "TerrainNoise.hpp"
+#include "Chunk.hpp"
+
+#include <FastNoise/FastNoise.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+const FastNoise::SmartNode<> fnGenerator = FastNoise::NewFromEncodedNodeTree(
+  "IgAAAIA/CtejPBkAIQAEAAAAAACamRlAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACQAACtcjPQEZAAQAAAAAAGZm5j8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABDQACAAAAAAAAQAcAAGZmZr8AAACAQA==");
+
+// Spacing of the coarse noise samples in voxels, CHUNK_SIZE has to be a multiple of it
+static constexpr int COARSE_STEP = 8;
+static constexpr int COARSE_SAMPLES = CHUNK_SIZE / COARSE_STEP + 1;
+static_assert(CHUNK_SIZE % COARSE_STEP == 0, "Coarse samples have to line up with the chunk borders");
+// Every voxel is at most half a cell diagonal away from a coarse sample
+static constexpr float COARSE_REACH = 0.8660254f;
+// Estimating the slope of the noise from the sample differences underestimates it, this much headroom is kept
+static constexpr float COARSE_SAFETY = 2.0f;
+// Octaves finer than COARSE_STEP barely show in the samples, the margin never drops below this
+static constexpr float MIN_COARSE_MARGIN = 0.05f;
+
+/**
+ *  @brief Writes the densities of count chunks in a row along x starting at firstPos, CHUNK_VOLUME floats per chunk
+ *  in voxel order. The noise grids x axis runs along the chunks z and its z axis along the chunks x, the voxels of
+ *  every chunk are a contiguous slab of the grid that way.
+ **/
+void TerrainNoise::evaluate(const glm::ivec3 &firstPos, size_t count, float *out) {
+  fnGenerator->GenUniformGrid3D(out,
+                                firstPos.z * CHUNK_SIZE,
+                                firstPos.y * CHUNK_SIZE,
+                                firstPos.x * CHUNK_SIZE,
+                                CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE * static_cast<int>(count), FREQUENCY, SEED);
+}
+
+/**
+ *  @brief Samples the noise every COARSE_STEP voxels, corners of the chunk included, and decides whether the chunk
+ *  is certainly all air, certainly all solid or has to be evaluated in full.
+ *  The largest difference between neighbouring samples bounds the slope of the noise, a voxel can't stray further
+ *  from its nearest sample than that slope allows over half a cell diagonal. Chunks whose samples aren't that far
+ *  away from SOLID_DENSITY are MIXED.
+ **/
+TerrainNoise::NoiseClass TerrainNoise::classify(const glm::ivec3 &pos) {
+  thread_local std::array<float, COARSE_SAMPLES * COARSE_SAMPLES * COARSE_SAMPLES> samples{};
+
+  // Same axis order and world positions as evaluate, at COARSE_STEP times the spacing
+  const int chunkSteps = CHUNK_SIZE / COARSE_STEP;
+  const FastNoise::OutputMinMax range = fnGenerator->GenUniformGrid3D(samples.data(),
+                                                                      pos.z * chunkSteps,
+                                                                      pos.y * chunkSteps,
+                                                                      pos.x * chunkSteps,
+                                                                      COARSE_SAMPLES, COARSE_SAMPLES, COARSE_SAMPLES,
+                                                                      FREQUENCY * COARSE_STEP, SEED);
+
+  // Samples within the smallest margin of SOLID_DENSITY are MIXED whatever the slope
+  if (range.min <= SOLID_DENSITY + MIN_COARSE_MARGIN && range.max > SOLID_DENSITY - MIN_COARSE_MARGIN) {
+    return NoiseClass::MIXED;
+  }
+
+  float maxStep = 0.0f;
+  auto at = [](int x, int y, int z) { return samples[x + y * COARSE_SAMPLES + z * COARSE_SAMPLES * COARSE_SAMPLES]; };
+  for (int z = 0; z < COARSE_SAMPLES; ++z) {
+    for (int y = 0; y < COARSE_SAMPLES; ++y) {
+      for (int x = 0; x < COARSE_SAMPLES; ++x) {
+        const float value = at(x, y, z);
+        if (x > 0) maxStep = std::max(maxStep, std::abs(value - at(x - 1, y, z)));
+        if (y > 0) maxStep = std::max(maxStep, std::abs(value - at(x, y - 1, z)));
+        if (z > 0) maxStep = std::max(maxStep, std::abs(value - at(x, y, z - 1)));
+      }
+    }
+  }
+  const float margin = std::max(MIN_COARSE_MARGIN, maxStep * COARSE_REACH * COARSE_SAFETY);
+
+  if (range.min > SOLID_DENSITY + margin) return NoiseClass::AIR;
+  if (range.max <= SOLID_DENSITY - margin) return NoiseClass::SOLID;
+  return NoiseClass::MIXED;
+}
+
+float TerrainNoise::sample(const glm::ivec3 &chunkPos, const glm::ivec3 &voxel) {
+  float density = 0.0f;
+  fnGenerator->GenUniformGrid3D(&density,
+                                chunkPos.z * CHUNK_SIZE + voxel.x,
+                                chunkPos.y * CHUNK_SIZE + voxel.y,
+                                chunkPos.x * CHUNK_SIZE + voxel.z,
+                                1, 1, 1, FREQUENCY, SEED);
+  return density;
+}
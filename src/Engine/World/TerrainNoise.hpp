@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/**
+ *  @brief The terrain density function, shared by the ChunkHandler and the headless benchmark.
+ *  Densities at or below SOLID_DENSITY are solid.
+ **/
+namespace TerrainNoise {
+  enum class NoiseClass { AIR, SOLID, MIXED };
+
+  // Every chunk generated from the same seed is identical across runs
+  inline const int SEED = 69;
+  inline const float FREQUENCY = 0.03f;
+
+  void evaluate(const glm::ivec3 &firstPos, size_t count, float *out);
+  NoiseClass classify(const glm::ivec3 &pos);
+  // Density of the voxel at chunk local position voxel, it may lie outside the chunk. One noise call per voxel.
+  float sample(const glm::ivec3 &chunkPos, const glm::ivec3 &voxel);
+}
@@ -1,26 +1,32 @@
 #include "VoxelAccess.hpp"
 #include "Util/Util.hpp"
 
-Material VoxelBoundaryAccess::getBlockAcross(Chunk *c, Direction dir, const glm::ivec3 &pos) {
+/**
+ *  @brief Returns the block on the other side of the chunk border.
+ *  @param c The neighbouring chunk in direction dir, nullptr counts as solid so no faces get generated into the unknown
+ *  @param pos Position on the border of the current chunk
+ **/
+Material VoxelBoundaryAccess::getBlockAcross(const Chunk *c, Direction dir, const glm::ivec3 &pos) {
   if (c == nullptr) return Materials::SOLID;
 
   glm::ivec3 flippedPos{};
 
+  // Voxel x runs along world Z and voxel z along world X, see TerrainNoise::evaluate
   switch (dir) {
     case Direction::NORTH: { // -Z
-      flippedPos = {pos.x, pos.y, 0};
+      flippedPos = {CHUNK_SIZE - 1, pos.y, pos.z};
     }
       break;
     case Direction::EAST: { // +X
-      flippedPos = {0, pos.y, pos.z};
+      flippedPos = {pos.x, pos.y, 0};
     }
       break;
     case Direction::SOUTH: { // +Z
-      flippedPos = {pos.x, pos.y, CHUNK_SIZE};
+      flippedPos = {0, pos.y, pos.z};
     }
       break;
     case Direction::WEST: { // -X
-      flippedPos = {CHUNK_SIZE, pos.y, pos.z};
+      flippedPos = {pos.x, pos.y, CHUNK_SIZE - 1};
     }
       break;
     case Direction::UP: { // +Y
@@ -28,12 +34,10 @@ Material VoxelBoundaryAccess::getBlockAcross(Chunk *c, Direction dir, const glm:
     }
       break;
     case Direction::DOWN: { // -Y
-      flippedPos = {pos.x, CHUNK_SIZE, pos.z};
+      flippedPos = {pos.x, CHUNK_SIZE - 1, pos.z};
     }
       break;
   }
 
-  Material mAcross = c->getBlock(flippedPos.x, flippedPos.y, flippedPos.z);
-  //LOG(D, "Material at " + Util::stringFromIVec3(flippedPos) + " is: " + std::to_string(mAcross.id));
-  return mAcross;
-}
\ No newline at end of file
+  return c->getBlockUnsafe(flippedPos.x, flippedPos.y, flippedPos.z);
+}
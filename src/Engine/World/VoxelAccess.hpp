@@ -2,6 +2,8 @@
 
 #include "Chunk.hpp"
 
+#include <array>
+
 enum class Direction {
   NORTH,
   EAST,
@@ -11,6 +13,37 @@ enum class Direction {
   DOWN
 };
 
+inline const glm::ivec3 directionOffsets[6] = {
+  {0, 0, -1}, // NORTH
+  {1, 0, 0},  // EAST
+  {0, 0, 1},  // SOUTH
+  {-1, 0, 0}, // WEST
+  {0, 1, 0},  // UP
+  {0, -1, 0}  // DOWN
+};
+
+inline Direction getOppositeDirection(Direction dir) {
+  switch (dir) {
+    case Direction::NORTH: return Direction::SOUTH;
+    case Direction::EAST: return Direction::WEST;
+    case Direction::SOUTH: return Direction::NORTH;
+    case Direction::WEST: return Direction::EAST;
+    case Direction::UP: return Direction::DOWN;
+    default: return Direction::UP;
+  }
+}
+
+/**
+ *  @brief The six face neighbours of a chunk indexed by Direction, entries can be nullptr.
+ **/
+struct ChunkNeighbours {
+  std::array<const Chunk*, 6> chunks{};
+
+  [[nodiscard]] inline const Chunk* get(Direction dir) const {
+    return chunks[static_cast<size_t>(dir)];
+  }
+};
+
 namespace VoxelBoundaryAccess {
-  Material getBlockAcross(Chunk* c, Direction dir, const glm::ivec3& pos);
+  Material getBlockAcross(const Chunk* c, Direction dir, const glm::ivec3& pos);
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "VoxelStorage.hpp"
+
+#include <Logging/Logger.h>
+
+#include <algorithm>
+
+// Index widths are powers of two so a packed index never straddles two words
+static constexpr int MAX_BITS_LOG2 = 4; // 16 bit -> 65536 palette entries
+
+static uint32_t wordsNeeded(uint32_t volume, int bitsLog2) {
+  uint32_t perWord = 64u >> bitsLog2;
+  return (volume + perWord - 1) / perWord;
+}
+
+VoxelStorage::VoxelStorage(uint32_t volume, Material fillMaterial) : volume(volume) {
+  palette.push_back(fillMaterial);
+}
+
+uint32_t VoxelStorage::getPaletteIndex(uint32_t index) const {
+  if (bitsLog2 < 0) return 0;
+  const uint32_t word = index >> (6 - bitsLog2);
+  const uint32_t shift = (index & ((64u >> bitsLog2) - 1)) << bitsLog2;
+  return static_cast<uint32_t>((data[word] >> shift) & indexMask);
+}
+
+void VoxelStorage::set(uint32_t index, Material material) {
+  if (index >= volume) return;
+  // Writing the material a uniform container already has must not allocate anything
+  if (bitsLog2 < 0 && palette[0] == material) return;
+
+  uint32_t paletteIndex = findOrAddPaletteEntry(material);
+
+  const uint32_t word = index >> (6 - bitsLog2);
+  const uint32_t shift = (index & ((64u >> bitsLog2) - 1)) << bitsLog2;
+  data[word] = (data[word] & ~(indexMask << shift)) | (static_cast<uint64_t>(paletteIndex) << shift);
+}
+
+/**
+ *  @brief Sets every voxel to the given material and drops all per voxel storage.
+ **/
+void VoxelStorage::fill(Material material) {
+  palette.clear();
+  palette.push_back(material);
+  data.clear();
+  data.shrink_to_fit();
+  bitsLog2 = -1;
+  indexMask = 0;
+}
+
+/**
+ *  @brief Rebuilds the palette with only the materials still in use and shrinks the index width accordingly.
+ *  Call this after bulk edits, a container that became uniform loses its voxel storage.
+ **/
+void VoxelStorage::compact() {
+  if (bitsLog2 < 0) return;
+
+  std::vector<uint32_t> remap(palette.size(), UINT32_MAX);
+  std::vector<Material> newPalette{};
+
+  for (uint32_t i = 0; i < volume; ++i) {
+    uint32_t old = getPaletteIndex(i);
+    if (remap[old] == UINT32_MAX) {
+      remap[old] = static_cast<uint32_t>(newPalette.size());
+      newPalette.push_back(palette[old]);
+    }
+  }
+
+  if (newPalette.size() == 1) {
+    fill(newPalette[0]);
+    return;
+  }
+
+  int newBitsLog2 = 0;
+  while ((1u << (1u << newBitsLog2)) < newPalette.size()) newBitsLog2++;
+
+  std::vector<uint64_t> newData(wordsNeeded(volume, newBitsLog2), 0);
+  const uint64_t newMask = (1ull << (1u << newBitsLog2)) - 1;
+  for (uint32_t i = 0; i < volume; ++i) {
+    const uint32_t word = i >> (6 - newBitsLog2);
+    const uint32_t shift = (i & ((64u >> newBitsLog2) - 1)) << newBitsLog2;
+    newData[word] |= static_cast<uint64_t>(remap[getPaletteIndex(i)]) << shift;
+  }
+
+  palette = std::move(newPalette);
+  data = std::move(newData);
+  bitsLog2 = newBitsLog2;
+  indexMask = newMask;
+}
+
+/**
+ *  @brief Replaces the contents with the given palette, every voxel points at palette index 0 afterwards.
+ *  Meant to be followed by setIndexRun calls when decoding, a single entry palette stays uniform.
+ **/
+void VoxelStorage::assignPalette(std::vector<Material> newPalette) {
+  if (newPalette.empty()) newPalette.push_back(Materials::AIR);
+  if (newPalette.size() == 1) {
+    fill(newPalette[0]);
+    return;
+  }
+
+  int newBitsLog2 = 0;
+  while ((1ull << (1u << newBitsLog2)) < newPalette.size()) newBitsLog2++;
+  if (newBitsLog2 > MAX_BITS_LOG2) {
+    LOGF(E, "VoxelStorage palette with %zu entries is too large, truncating", newPalette.size());
+    newBitsLog2 = MAX_BITS_LOG2;
+    newPalette.resize(1ull << (1u << MAX_BITS_LOG2));
+  }
+
+  palette = std::move(newPalette);
+  data.assign(wordsNeeded(volume, newBitsLog2), 0);
+  bitsLog2 = newBitsLog2;
+  indexMask = (1ull << (1u << newBitsLog2)) - 1;
+}
+
+/**
+ *  @brief Points count voxels starting at begin to an existing palette entry without searching the palette.
+ **/
+void VoxelStorage::setIndexRun(uint32_t begin, uint32_t count, uint32_t paletteIndex) {
+  if (bitsLog2 < 0 || paletteIndex >= palette.size()) return;
+  const uint32_t end = std::min(begin + count, volume);
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t word = i >> (6 - bitsLog2);
+    const uint32_t shift = (i & ((64u >> bitsLog2) - 1)) << bitsLog2;
+    data[word] = (data[word] & ~(indexMask << shift)) | (static_cast<uint64_t>(paletteIndex) << shift);
+  }
+}
+
+/**
+ *  @brief Two material contents straight from a bit mask, bit i of mask[i / 64] set means set, otherwise clear.
+ *  The mask has exactly the 1 bit index layout, so it is copied as is.
+ **/
+void VoxelStorage::assignMask(const uint64_t *mask, Material clear, Material set) {
+  palette = {clear, set};
+  data.assign(mask, mask + wordsNeeded(volume, 0));
+  bitsLog2 = 0;
+  indexMask = 1;
+}
+
+uint32_t VoxelStorage::findOrAddPaletteEntry(Material material) {
+  for (uint32_t i = 0; i < palette.size(); ++i) {
+    if (palette[i] == material) {
+      if (bitsLog2 < 0) repack(0);
+      return i;
+    }
+  }
+
+  palette.push_back(material);
+
+  int requiredBitsLog2 = bitsLog2 < 0 ? 0 : bitsLog2;
+  while ((1ull << (1u << requiredBitsLog2)) < palette.size()) requiredBitsLog2++;
+
+  if (requiredBitsLog2 > MAX_BITS_LOG2) {
+    LOG(E, "VoxelStorage palette overflow, compacting");
+    palette.pop_back();
+    compact();
+    palette.push_back(material);
+    requiredBitsLog2 = bitsLog2 < 0 ? 0 : bitsLog2;
+    while ((1ull << (1u << requiredBitsLog2)) < palette.size()) requiredBitsLog2++;
+  }
+
+  if (requiredBitsLog2 != bitsLog2) repack(requiredBitsLog2);
+  return static_cast<uint32_t>(palette.size() - 1);
+}
+
+/**
+ *  @brief Widens the packed indices, a uniform container gets expanded with palette index 0 everywhere.
+ **/
+void VoxelStorage::repack(int newBitsLog2) {
+  std::vector<uint64_t> newData(wordsNeeded(volume, newBitsLog2), 0);
+  const uint64_t newMask = (1ull << (1u << newBitsLog2)) - 1;
+
+  if (bitsLog2 >= 0) {
+    for (uint32_t i = 0; i < volume; ++i) {
+      const uint32_t word = i >> (6 - newBitsLog2);
+      const uint32_t shift = (i & ((64u >> newBitsLog2) - 1)) << newBitsLog2;
+      newData[word] |= static_cast<uint64_t>(getPaletteIndex(i)) << shift;
+    }
+  }
+
+  data = std::move(newData);
+  bitsLog2 = newBitsLog2;
+  indexMask = newMask;
+}
+
+bool VoxelStorage::isUniform() const {
+  return bitsLog2 < 0;
+}
+
+uint32_t VoxelStorage::getVolume() const {
+  return volume;
+}
+
+uint32_t VoxelStorage::getBitsPerVoxel() const {
+  return bitsLog2 < 0 ? 0 : (1u << bitsLog2);
+}
+
+const std::vector<Material> &VoxelStorage::getPalette() const {
+  return palette;
+}
+
+size_t VoxelStorage::getMemoryUsage() const {
+  return sizeof(VoxelStorage) + palette.capacity() * sizeof(Material) + data.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Block.hpp"
+
+/**
+ *  @brief Palette compressed voxel container.
+ *  Every voxel stores a bit-packed index into a per-container palette, the index width grows with the palette
+ *  (0, 1, 2, 4, 8 or 16 bits). A container that only holds a single material has no per voxel storage at all.
+ **/
+class VoxelStorage {
+public:
+  explicit VoxelStorage(uint32_t volume, Material fillMaterial = Materials::AIR);
+
+  [[nodiscard]] inline Material get(uint32_t index) const {
+    if (bitsLog2 < 0) return palette[0];
+    const uint32_t word = index >> (6 - bitsLog2);
+    const uint32_t shift = (index & ((64u >> bitsLog2) - 1)) << bitsLog2;
+    return palette[(data[word] >> shift) & indexMask];
+  }
+
+  void set(uint32_t index, Material material);
+  void fill(Material material);
+  void compact();
+
+  // Bulk access for serialization, indices refer to getPalette()
+  [[nodiscard]] uint32_t getPaletteIndex(uint32_t index) const;
+  void assignPalette(std::vector<Material> newPalette);
+  void setIndexRun(uint32_t begin, uint32_t count, uint32_t paletteIndex);
+  void assignMask(const uint64_t *mask, Material clear, Material set);
+
+  [[nodiscard]] bool isUniform() const;
+  [[nodiscard]] uint32_t getVolume() const;
+  [[nodiscard]] uint32_t getBitsPerVoxel() const;
+  [[nodiscard]] const std::vector<Material> &getPalette() const;
+  [[nodiscard]] size_t getMemoryUsage() const;
+
+private:
+  uint32_t findOrAddPaletteEntry(Material material);
+  void repack(int newBitsLog2);
+
+  uint32_t volume;
+
+  // log2 of the index width, -1 means uniform (no index data)
+  int bitsLog2 = -1;
+  uint64_t indexMask = 0;
+
+  std::vector<Material> palette{};
+  std::vector<uint64_t> data{};
+};